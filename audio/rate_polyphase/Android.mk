@@ -0,0 +1,28 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libasound_module_rate_polyphase
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_PATH := $(TARGET_OUT)/usr/lib/alsa-lib
+LOCAL_SRC_FILES := resampler.c rate_polyphase.c
+# libasound ships as a vendor blob, not as a module built here: link
+# against that binary so the plugin binds to the library that loads it.
+# The headers have to be from the same alsa-lib release as the blob.
+LOCAL_C_INCLUDES := external/alsa-lib/include
+LOCAL_LDFLAGS := $(TOP)/vendor/lge/p880/proprietary/lib/libasound.so
+LOCAL_ARM_MODE := arm
+ifeq ($(ARCH_ARM_HAVE_NEON),true)
+LOCAL_ARM_NEON := true
+endif
+
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := resampler_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := resampler.c resampler_bench.c
+LOCAL_LDLIBS := -lm -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * ALSA rate converter plugin wrapping the polyphase resampler. It is
+ * loaded by the rate/plug PCMs with
+ *
+ *   rate_converter "polyphase"
+ *
+ * alsa-lib converts to and from interleaved S16 around convert_s16, so
+ * only that entry point is provided.
+ *
+ * asound.conf does not select it yet, and it is not in PRODUCT_PACKAGES;
+ * build it with mmm to try it. The default and music routes stay on
+ * "linear" until resampler_bench shows, with NEON on the handset, that
+ * this converter costs no more CPU than that one.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <alsa/asoundlib.h>
+#include <alsa/pcm_rate.h>
+
+#include "resampler.h"
+
+struct rate_polyphase {
+    struct resampler *rs;
+    unsigned int in_rate;
+    unsigned int out_rate;
+    unsigned int channels;
+};
+
+static snd_pcm_uframes_t input_frames(void *obj, snd_pcm_uframes_t frames)
+{
+    struct rate_polyphase *rate = obj;
+
+    if (frames == 0)
+        return 0;
+    return ((unsigned long long) frames * rate->in_rate +
+            rate->out_rate / 2) / rate->out_rate;
+}
+
+static snd_pcm_uframes_t output_frames(void *obj, snd_pcm_uframes_t frames)
+{
+    struct rate_polyphase *rate = obj;
+
+    if (frames == 0)
+        return 0;
+    return ((unsigned long long) frames * rate->out_rate +
+            rate->in_rate / 2) / rate->in_rate;
+}
+
+static void pp_free(void *obj)
+{
+    struct rate_polyphase *rate = obj;
+
+    resampler_destroy(rate->rs);
+    rate->rs = NULL;
+}
+
+static int pp_init(void *obj, snd_pcm_rate_info_t *info)
+{
+    struct rate_polyphase *rate = obj;
+
+    if (rate->rs == NULL || rate->in_rate != info->in.rate ||
+        rate->out_rate != info->out.rate ||
+        rate->channels != info->channels) {
+        pp_free(obj);
+        rate->rs = resampler_create(info->in.rate, info->out.rate,
+                                    info->channels);
+        if (rate->rs == NULL)
+            return -EINVAL;
+        rate->in_rate = info->in.rate;
+        rate->out_rate = info->out.rate;
+        rate->channels = info->channels;
+    }
+    resampler_reset(rate->rs);
+    return 0;
+}
+
+static int pp_adjust_pitch(void *obj, snd_pcm_rate_info_t *info)
+{
+    /* the step is derived from the period sizes on every convert call */
+    return 0;
+}
+
+static void pp_reset(void *obj)
+{
+    struct rate_polyphase *rate = obj;
+
+    if (rate->rs)
+        resampler_reset(rate->rs);
+}
+
+static void pp_convert_s16(void *obj, int16_t *dst, unsigned int dst_frames,
+                           const int16_t *src, unsigned int src_frames)
+{
+    struct rate_polyphase *rate = obj;
+
+    resampler_process(rate->rs, dst, dst_frames, src, src_frames);
+}
+
+static void pp_close(void *obj)
+{
+    pp_free(obj);
+    free(obj);
+}
+
+#if SND_PCM_RATE_PLUGIN_VERSION >= 0x010002
+static void pp_dump(void *obj, snd_output_t *out)
+{
+    snd_output_printf(out, "Converter: polyphase (%s)\n", resampler_impl());
+}
+#endif
+
+static snd_pcm_rate_ops_t polyphase_ops = {
+    .close = pp_close,
+    .init = pp_init,
+    .free = pp_free,
+    .reset = pp_reset,
+    .adjust_pitch = pp_adjust_pitch,
+    .convert_s16 = pp_convert_s16,
+    .input_frames = input_frames,
+    .output_frames = output_frames,
+#if SND_PCM_RATE_PLUGIN_VERSION >= 0x010002
+    .version = SND_PCM_RATE_PLUGIN_VERSION,
+    .dump = pp_dump,
+#endif
+};
+
+int SND_PCM_RATE_PLUGIN_ENTRY(polyphase) (unsigned int version, void **objp,
+                                          snd_pcm_rate_ops_t *ops)
+{
+    struct rate_polyphase *rate;
+
+#if SND_PCM_RATE_PLUGIN_VERSION < 0x010002
+    if (version != SND_PCM_RATE_PLUGIN_VERSION) {
+        fprintf(stderr, "Invalid rate plugin version %x\n", version);
+        return -EINVAL;
+    }
+#endif
+
+    rate = calloc(1, sizeof(*rate));
+    if (rate == NULL)
+        return -ENOMEM;
+
+    *objp = rate;
+#if SND_PCM_RATE_PLUGIN_VERSION >= 0x010002
+    if (version == 0x010001)
+        memcpy(ops, &polyphase_ops, sizeof(snd_pcm_rate_old_ops_t));
+    else
+#endif
+        *ops = polyphase_ops;
+    return 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#include "resampler.h"
+
+#define KAISER_BETA     7.5
+#define PASSBAND        0.92
+#define COEF_SHIFT      15
+#define ONE             (1ULL << 32)
+
+struct resampler {
+    unsigned int in_rate;
+    unsigned int out_rate;
+    unsigned int channels;
+
+    /* 32.32 fixed point input position of the next output frame */
+    uint64_t frac;
+
+    /*
+     * RESAMPLER_PHASES + 1 phases so that phase p + 1 always exists for
+     * the interpolation; the last one is phase 0 shifted by a full tap.
+     */
+    int16_t coefs[RESAMPLER_PHASES + 1][RESAMPLER_TAPS]
+            __attribute__((aligned(16)));
+
+    /*
+     * Per channel history, stored twice so that the newest
+     * RESAMPLER_TAPS samples are always contiguous from hist_pos.
+     */
+    int16_t hist[RESAMPLER_MAX_CHANNELS][2 * RESAMPLER_TAPS]
+            __attribute__((aligned(16)));
+    unsigned int hist_pos;
+};
+
+static double bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k = 1; k < 32; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+static void design_filter(struct resampler *rs)
+{
+    /* cutoff in cycles per input sample, below the lower Nyquist rate */
+    double ratio = (double) rs->out_rate / rs->in_rate;
+    double fc = 0.5 * PASSBAND * (ratio < 1.0 ? ratio : 1.0);
+    double half = RESAMPLER_TAPS / 2;
+    double norm = bessel_i0(KAISER_BETA);
+    int p, k;
+
+    for (p = 0; p <= RESAMPLER_PHASES; p++) {
+        double h[RESAMPLER_TAPS];
+        double sum = 0.0;
+        int acc = 0, peak = 0;
+
+        for (k = 0; k < RESAMPLER_TAPS; k++) {
+            double x = k - (half - 1) - (double) p / RESAMPLER_PHASES;
+            double s = x == 0.0 ? 1.0 : sin(2 * M_PI * fc * x) /
+                                        (2 * M_PI * fc * x);
+            double w = x / half;
+
+            w = fabs(w) >= 1.0 ? 0.0 :
+                bessel_i0(KAISER_BETA * sqrt(1.0 - w * w)) / norm;
+            h[k] = s * w;
+            sum += h[k];
+        }
+
+        /* unity DC gain per phase, rounding error folded into the peak */
+        for (k = 0; k < RESAMPLER_TAPS; k++) {
+            rs->coefs[p][k] = (int16_t) lrint(h[k] / sum * (1 << COEF_SHIFT)
+                                              * 0.999);
+            acc += rs->coefs[p][k];
+            if (abs(rs->coefs[p][k]) > abs(rs->coefs[p][peak]))
+                peak = k;
+        }
+        rs->coefs[p][peak] += (int) ((1 << COEF_SHIFT) * 0.999) - acc;
+    }
+}
+
+struct resampler *resampler_create(unsigned int in_rate,
+                                   unsigned int out_rate,
+                                   unsigned int channels)
+{
+    struct resampler *rs;
+
+    if (!in_rate || !out_rate || !channels ||
+        channels > RESAMPLER_MAX_CHANNELS)
+        return NULL;
+
+    rs = calloc(1, sizeof(*rs));
+    if (rs == NULL)
+        return NULL;
+
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->channels = channels;
+    design_filter(rs);
+
+    return rs;
+}
+
+void resampler_destroy(struct resampler *rs)
+{
+    free(rs);
+}
+
+void resampler_reset(struct resampler *rs)
+{
+    rs->frac = 0;
+    rs->hist_pos = 0;
+    memset(rs->hist, 0, sizeof(rs->hist));
+}
+
+static inline void push_frame(struct resampler *rs, const int16_t *frame)
+{
+    unsigned int pos = rs->hist_pos;
+    unsigned int ch;
+
+    for (ch = 0; ch < rs->channels; ch++) {
+        rs->hist[ch][pos] = frame[ch];
+        rs->hist[ch][pos + RESAMPLER_TAPS] = frame[ch];
+    }
+    rs->hist_pos = (pos + 1) & (RESAMPLER_TAPS - 1);
+}
+
+static inline int16_t clamp16(int32_t v)
+{
+    if (v > 32767)
+        return 32767;
+    if (v < -32768)
+        return -32768;
+    return v;
+}
+
+#ifdef __ARM_NEON__
+
+const char *resampler_impl(void)
+{
+    return "neon";
+}
+
+/* Both neighbouring phases in one pass so the history is loaded once. */
+static inline void dot2(const int16_t *x, const int16_t *h0,
+                        const int16_t *h1, int32_t *a, int32_t *b)
+{
+    int32x4_t acc0 = vdupq_n_s32(0);
+    int32x4_t acc1 = vdupq_n_s32(0);
+    int32x2_t r;
+    int k;
+
+    for (k = 0; k < RESAMPLER_TAPS; k += 8) {
+        int16x8_t v = vld1q_s16(x + k);
+        int16x8_t c0 = vld1q_s16(h0 + k);
+        int16x8_t c1 = vld1q_s16(h1 + k);
+
+        acc0 = vmlal_s16(acc0, vget_low_s16(v), vget_low_s16(c0));
+        acc0 = vmlal_s16(acc0, vget_high_s16(v), vget_high_s16(c0));
+        acc1 = vmlal_s16(acc1, vget_low_s16(v), vget_low_s16(c1));
+        acc1 = vmlal_s16(acc1, vget_high_s16(v), vget_high_s16(c1));
+    }
+
+    r = vpadd_s32(vadd_s32(vget_low_s32(acc0), vget_high_s32(acc0)),
+                  vadd_s32(vget_low_s32(acc1), vget_high_s32(acc1)));
+    *a = vget_lane_s32(r, 0);
+    *b = vget_lane_s32(r, 1);
+}
+
+#else
+
+const char *resampler_impl(void)
+{
+    return "scalar";
+}
+
+static inline void dot2(const int16_t *x, const int16_t *h0,
+                        const int16_t *h1, int32_t *a, int32_t *b)
+{
+    int32_t acc0 = 0, acc1 = 0;
+    int k;
+
+    for (k = 0; k < RESAMPLER_TAPS; k++) {
+        acc0 += x[k] * h0[k];
+        acc1 += x[k] * h1[k];
+    }
+    *a = acc0;
+    *b = acc1;
+}
+
+#endif
+
+void resampler_process(struct resampler *rs,
+                       int16_t *dst, unsigned int dst_frames,
+                       const int16_t *src, unsigned int src_frames)
+{
+    const unsigned int channels = rs->channels;
+    const int16_t *end = src + src_frames * channels;
+    uint64_t step;
+    uint64_t frac = rs->frac;
+    unsigned int n, ch;
+
+    if (dst_frames == 0)
+        return;
+
+    /* consume exactly src_frames over this call, as the period sizes ask */
+    step = ((uint64_t) src_frames << 32) / dst_frames;
+
+    for (n = 0; n < dst_frames; n++) {
+        unsigned int p;
+        int32_t w;
+
+        while (frac >= ONE) {
+            if (src < end) {
+                push_frame(rs, src);
+                src += channels;
+            }
+            frac -= ONE;
+        }
+
+        p = frac >> (32 - RESAMPLER_PHASE_BITS);
+        w = (frac >> (32 - RESAMPLER_PHASE_BITS - 15)) & 0x7fff;
+
+        for (ch = 0; ch < channels; ch++) {
+            int32_t a, b;
+
+            dot2(&rs->hist[ch][rs->hist_pos], rs->coefs[p],
+                 rs->coefs[p + 1], &a, &b);
+            a >>= COEF_SHIFT;
+            b >>= COEF_SHIFT;
+            *dst++ = clamp16(a + (int32_t) (((int64_t) (b - a) * w) >> 15));
+        }
+        frac += step;
+    }
+
+    /* the step is rounded down, so at most one frame can be left over */
+    while (src < end) {
+        push_frame(rs, src);
+        src += channels;
+        frac = frac >= ONE ? frac - ONE : 0;
+    }
+    rs->frac = frac;
+}
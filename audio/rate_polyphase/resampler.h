@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RESAMPLER_H_
+#define _RESAMPLER_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Polyphase windowed-sinc resampler for interleaved S16 audio.
+ *
+ * The filter bank has RESAMPLER_PHASES phases of RESAMPLER_TAPS taps and
+ * the output is interpolated between the two nearest phases, so any rate
+ * ratio works, not only 44.1k to 48k. Each call to resampler_process()
+ * consumes exactly src_frames and produces exactly dst_frames, matching
+ * how the ALSA rate plugin hands over whole periods.
+ */
+
+#define RESAMPLER_TAPS          32
+#define RESAMPLER_PHASE_BITS    7
+#define RESAMPLER_PHASES        (1 << RESAMPLER_PHASE_BITS)
+#define RESAMPLER_MAX_CHANNELS  8
+
+struct resampler;
+
+struct resampler *resampler_create(unsigned int in_rate,
+                                   unsigned int out_rate,
+                                   unsigned int channels);
+void resampler_destroy(struct resampler *rs);
+void resampler_reset(struct resampler *rs);
+void resampler_process(struct resampler *rs,
+                       int16_t *dst, unsigned int dst_frames,
+                       const int16_t *src, unsigned int src_frames);
+
+/* Name of the inner loop compiled in, "neon" or "scalar". */
+const char *resampler_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Quality and throughput benchmark of the polyphase resampler against
+ * the stock alsa-lib "linear" converter, which is what the plug PCMs in
+ * asound.conf use today.
+ *
+ * Built with HAVE_ALSA, the linear numbers come from alsa-lib itself: the
+ * input is played into a rate PCM with converter "linear" over a file
+ * PCM, which needs no sound card, and the file is read back. A model of
+ * the converter (same interpolation between neighbouring frames, same
+ * per-period pitch) is always run too, so the two can be checked against
+ * each other and the bench still builds without alsa-lib:
+ *
+ *   gcc -O2 -DHAVE_ALSA -o resampler_bench resampler.c resampler_bench.c \
+ *       -lm -lasound
+ *
+ * Quality is the signal to noise and distortion ratio of a resampled
+ * sine; throughput is nanoseconds per stereo output frame. The alsa-lib
+ * figure includes the PCM plumbing and the file writes, so it is an
+ * upper bound for the converter alone.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "resampler.h"
+
+#define CHANNELS    2
+#define OUT_PERIOD  1024
+
+struct linear {
+    uint64_t frac;
+    int16_t old[CHANNELS];
+    int16_t cur[CHANNELS];
+};
+
+static void linear_process(struct linear *lin, int16_t *dst,
+                           unsigned int dst_frames, const int16_t *src,
+                           unsigned int src_frames)
+{
+    const int16_t *end = src + src_frames * CHANNELS;
+    uint64_t step = ((uint64_t) src_frames << 32) / dst_frames;
+    unsigned int n, ch;
+
+    for (n = 0; n < dst_frames; n++) {
+        int32_t w;
+
+        while (lin->frac >= (1ULL << 32)) {
+            if (src < end) {
+                memcpy(lin->old, lin->cur, sizeof(lin->old));
+                memcpy(lin->cur, src, sizeof(lin->cur));
+                src += CHANNELS;
+            }
+            lin->frac -= 1ULL << 32;
+        }
+        w = lin->frac >> 17;
+        for (ch = 0; ch < CHANNELS; ch++)
+            *dst++ = lin->old[ch] + (((lin->cur[ch] - lin->old[ch]) * w) >> 15);
+        lin->frac += step;
+    }
+    while (src < end) {
+        memcpy(lin->old, lin->cur, sizeof(lin->old));
+        memcpy(lin->cur, src, sizeof(lin->cur));
+        src += CHANNELS;
+        lin->frac = lin->frac >= (1ULL << 32) ? lin->frac - (1ULL << 32) : 0;
+    }
+}
+
+static unsigned int in_period_for(unsigned int in_rate, unsigned int out_rate)
+{
+    return ((unsigned long long) OUT_PERIOD * in_rate + out_rate / 2) /
+           out_rate;
+}
+
+/* Feed in_frames through either converter in ALSA sized periods. */
+static unsigned int convert(struct resampler *rs, struct linear *lin,
+                            unsigned int in_rate, unsigned int out_rate,
+                            const int16_t *in, unsigned int in_frames,
+                            int16_t *out)
+{
+    unsigned int in_period = in_period_for(in_rate, out_rate);
+    unsigned int done = 0, produced = 0;
+
+    while (done + in_period <= in_frames) {
+        if (rs)
+            resampler_process(rs, out + produced * CHANNELS, OUT_PERIOD,
+                              in + done * CHANNELS, in_period);
+        else
+            linear_process(lin, out + produced * CHANNELS, OUT_PERIOD,
+                           in + done * CHANNELS, in_period);
+        done += in_period;
+        produced += OUT_PERIOD;
+    }
+    return produced;
+}
+
+#ifdef HAVE_ALSA
+/*
+ * Runs in_frames through alsa-lib's own rate plugin with the named
+ * converter and returns the number of frames it produced, or 0.
+ */
+static unsigned int alsa_convert(const char *converter, unsigned int in_rate,
+                                 unsigned int out_rate, const int16_t *in,
+                                 unsigned int in_frames, int16_t *out,
+                                 unsigned int out_max)
+{
+    char path[] = "/tmp/resampler_bench.XXXXXX";
+    char conf[512];
+    snd_config_t *top = NULL;
+    snd_input_t *input;
+    snd_pcm_t *pcm = NULL;
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_uframes_t period = in_period_for(in_rate, out_rate);
+    snd_pcm_uframes_t buffer = period * 4;
+    unsigned int rate = in_rate, done = 0, produced = 0;
+    FILE *f;
+    int fd, err;
+
+    fd = mkstemp(path);
+    if (fd < 0)
+        return 0;
+    close(fd);
+
+    snprintf(conf, sizeof(conf),
+             "pcm.bench { type rate converter \"%s\" slave { rate %u "
+             "pcm { type file file \"%s\" format raw "
+             "slave.pcm { type null } } } }", converter, out_rate, path);
+
+    if ((err = snd_config_top(&top)) < 0 ||
+        (err = snd_input_buffer_open(&input, conf, -1)) < 0)
+        goto out;
+    err = snd_config_load(top, input);
+    snd_input_close(input);
+    if (err < 0 ||
+        (err = snd_pcm_open_lconf(&pcm, "bench", SND_PCM_STREAM_PLAYBACK,
+                                  0, top)) < 0)
+        goto out;
+
+    snd_pcm_hw_params_alloca(&hw);
+    if ((err = snd_pcm_hw_params_any(pcm, hw)) < 0 ||
+        (err = snd_pcm_hw_params_set_access(pcm, hw,
+                SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(pcm, hw,
+                SND_PCM_FORMAT_S16_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, hw, CHANNELS)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, 0)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(pcm, hw,
+                &period, 0)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(pcm, hw,
+                &buffer)) < 0 ||
+        (err = snd_pcm_hw_params(pcm, hw)) < 0)
+        goto out;
+
+    while (done + period <= in_frames) {
+        snd_pcm_sframes_t n = snd_pcm_writei(pcm, in + done * CHANNELS,
+                                             period);
+        if (n < 0 && (n = snd_pcm_recover(pcm, n, 1)) < 0) {
+            err = n;
+            goto out;
+        }
+        done += n;
+    }
+    snd_pcm_drain(pcm);
+    snd_pcm_close(pcm);
+    pcm = NULL;
+
+    f = fopen(path, "rb");
+    if (f) {
+        produced = fread(out, CHANNELS * sizeof(int16_t), out_max, f);
+        fclose(f);
+    }
+
+out:
+    if (err < 0)
+        fprintf(stderr, "alsa-lib %s: %s\n", converter, snd_strerror(err));
+    if (pcm)
+        snd_pcm_close(pcm);
+    if (top)
+        snd_config_delete(top);
+    unlink(path);
+    return produced;
+}
+#endif
+
+/*
+ * Least squares fit of a sine at the expected frequency; everything that
+ * does not fit is noise and distortion.
+ */
+static double sinad(const int16_t *out, unsigned int frames, double freq)
+{
+    double sxx = 0, syy = 0, sxy = 0, sx = 0, sy = 0, sz = 0;
+    double szx = 0, szy = 0, szz = 0, det, a, b, c;
+    double sig = 0, err = 0;
+    unsigned int n;
+
+    for (n = 0; n < frames; n++) {
+        double x = sin(2 * M_PI * freq * n), y = cos(2 * M_PI * freq * n);
+        double z = out[n * CHANNELS];
+        sxx += x * x; syy += y * y; sxy += x * y;
+        sx += x; sy += y;
+        szx += z * x; szy += z * y; sz += z; szz += z * z;
+    }
+
+    /* solve the 3x3 normal equations for z ~ a*x + b*y + c */
+    det = sxx * (syy * frames - sy * sy) - sxy * (sxy * frames - sy * sx) +
+          sx * (sxy * sy - syy * sx);
+    a = (szx * (syy * frames - sy * sy) - sxy * (szy * frames - sy * sz) +
+         sx * (szy * sy - syy * sz)) / det;
+    b = (sxx * (szy * frames - sz * sy) - szx * (sxy * frames - sy * sx) +
+         sx * (sxy * sz - szy * sx)) / det;
+    c = (sxx * (syy * sz - sy * szy) - sxy * (sxy * sz - sy * szx) +
+         sx * (sxy * szy - syy * szx)) / det;
+
+    for (n = 0; n < frames; n++) {
+        double x = sin(2 * M_PI * freq * n), y = cos(2 * M_PI * freq * n);
+        double fit = a * x + b * y + c;
+        double d = out[n * CHANNELS] - fit;
+        sig += fit * fit;
+        err += d * d;
+    }
+    return err > 0 ? 10 * log10(sig / err) : 200.0;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    static const double tones[] = { 100, 1000, 5000, 10000, 15000, 19000 };
+    unsigned int in_rate = argc > 1 ? atoi(argv[1]) : 44100;
+    unsigned int out_rate = argc > 2 ? atoi(argv[2]) : 48000;
+    unsigned int seconds = argc > 3 ? atoi(argv[3]) : 30;
+    unsigned int in_frames = in_rate * seconds;
+    unsigned int out_max = (unsigned long long) in_frames * out_rate /
+                           in_rate + 2 * OUT_PERIOD;
+    unsigned int skip = 4 * OUT_PERIOD;
+    int16_t *in = malloc(in_frames * CHANNELS * sizeof(int16_t));
+    int16_t *out = malloc(out_max * CHANNELS * sizeof(int16_t));
+    struct resampler *rs;
+    struct linear lin;
+    unsigned int i, n, produced;
+    double t, t_poly, t_lin;
+#ifdef HAVE_ALSA
+    double t_alsa;
+#endif
+
+    rs = resampler_create(in_rate, out_rate, CHANNELS);
+    if (in == NULL || out == NULL || rs == NULL) {
+        fprintf(stderr, "setup failed\n");
+        return 1;
+    }
+
+    printf("%u -> %u Hz, %d taps x %d phases, %s\n", in_rate, out_rate,
+           RESAMPLER_TAPS, RESAMPLER_PHASES, resampler_impl());
+#ifdef HAVE_ALSA
+    printf("%8s %12s %12s %12s\n", "tone Hz", "alsa-lib dB", "model dB",
+           "polyphase dB");
+#else
+    printf("%8s %12s %12s\n", "tone Hz", "model dB", "polyphase dB");
+#endif
+
+    for (i = 0; i < sizeof(tones) / sizeof(tones[0]); i++) {
+        /* whole periods set the real pitch, exactly as in alsa-lib */
+        double freq = tones[i] / in_rate * in_period_for(in_rate, out_rate) /
+                      OUT_PERIOD;
+        double snr_lin, snr_poly;
+#ifdef HAVE_ALSA
+        double snr_alsa = 0;
+#endif
+
+        if (tones[i] >= 0.45 * (in_rate < out_rate ? in_rate : out_rate))
+            continue;
+        for (n = 0; n < in_rate; n++) {
+            int16_t v = lrint(16384 * sin(2 * M_PI * tones[i] * n / in_rate));
+            in[n * CHANNELS] = in[n * CHANNELS + 1] = v;
+        }
+
+        memset(&lin, 0, sizeof(lin));
+        produced = convert(NULL, &lin, in_rate, out_rate, in, in_rate, out);
+        snr_lin = sinad(out + skip * CHANNELS, produced - skip, freq);
+
+        resampler_reset(rs);
+        produced = convert(rs, NULL, in_rate, out_rate, in, in_rate, out);
+        snr_poly = sinad(out + skip * CHANNELS, produced - skip, freq);
+
+#ifdef HAVE_ALSA
+        produced = alsa_convert("linear", in_rate, out_rate, in, in_rate,
+                                out, out_max);
+        if (produced > skip)
+            snr_alsa = sinad(out + skip * CHANNELS, produced - skip, freq);
+        printf("%8.0f %12.1f %12.1f %12.1f\n", tones[i], snr_alsa, snr_lin,
+               snr_poly);
+#else
+        printf("%8.0f %12.1f %12.1f\n", tones[i], snr_lin, snr_poly);
+#endif
+    }
+
+    /* throughput on noise so nothing is predictable */
+    srand(1);
+    for (n = 0; n < in_frames * CHANNELS; n++)
+        in[n] = (rand() & 0xffff) - 0x8000;
+
+    memset(&lin, 0, sizeof(lin));
+    t = now();
+    produced = convert(NULL, &lin, in_rate, out_rate, in, in_frames, out);
+    t_lin = now() - t;
+
+    resampler_reset(rs);
+    t = now();
+    produced = convert(rs, NULL, in_rate, out_rate, in, in_frames, out);
+    t_poly = now() - t;
+
+#ifdef HAVE_ALSA
+    t = now();
+    n = alsa_convert("linear", in_rate, out_rate, in, in_frames, out,
+                     out_max);
+    t_alsa = now() - t;
+#endif
+
+    printf("%u s of stereo audio\n", seconds);
+#ifdef HAVE_ALSA
+    if (n)
+        printf("alsa-lib:  %7.1f ns/frame, %7.0fx realtime\n",
+               t_alsa * 1e9 / n, seconds / t_alsa);
+#endif
+    printf("model:     %7.1f ns/frame, %7.0fx realtime\n",
+           t_lin * 1e9 / produced, seconds / t_lin);
+    printf("polyphase: %7.1f ns/frame, %7.0fx realtime\n",
+           t_poly * 1e9 / produced, seconds / t_poly);
+
+    resampler_destroy(rs);
+    free(in);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,586 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Input driven CPU boost.
+ *
+ * Touch, key and screen-on events briefly raise scaling_min_freq and
+ * bring extra cores online through the usual cpufreq/hotplug sysfs
+ * nodes, then hand control back to the interactive governor and
+ * auto_hotplug. Boosts are described by profiles in boostd.conf.
+ *
+ * The frequency restored after a boost is base_min_freq from the config,
+ * or cpuinfo_min_freq, never the live scaling_min_freq: that may still
+ * hold a boost left by an instance that was killed. It is written at
+ * startup and again on SIGTERM/SIGINT and every other exit path.
+ *
+ * Only touchscreens (ABS_MT_POSITION_X or BTN_TOUCH, or a direct input
+ * device with ABS_X) trigger the touch profile and only devices with
+ * real keys trigger the key one, so sensors reporting through EV_ABS do
+ * not keep the CPU boosted. Devices with neither are not opened.
+ *
+ * Everything the daemon touches can be redirected for testing:
+ *   -r root    sysfs root instead of /sys
+ *   -i device  input device to watch, may be repeated (default: all
+ *              /dev/input/event*); a file that is not an evdev node,
+ *              such as a FIFO, is treated as both touch and keys
+ *   -w dir     directory holding wait_for_fb_wake and wait_for_fb_sleep
+ *              (default: <root>/power), "" to disable; FIFOs work as
+ *              fakes since reads block until something is written
+ */
+
+#define LOG_TAG "boostd"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+
+#include <linux/input.h>
+
+#ifdef ANDROID
+#include <cutils/log.h>
+#else
+#define ALOGE(...) (fprintf(stderr, "E/" LOG_TAG ": " __VA_ARGS__), \
+                    fputc('\n', stderr))
+#define ALOGI(...) (fprintf(stderr, "I/" LOG_TAG ": " __VA_ARGS__), \
+                    fputc('\n', stderr))
+#endif
+
+#define DEFAULT_CONFIG      "/system/etc/boostd.conf"
+#define DEFAULT_SYSFS       "/sys"
+#define INPUT_DIR           "/dev/input"
+#define MAX_INPUTS          16
+#define MAX_CPUS            4
+
+/* byte written to the wake pipe by the signal handler */
+#define WAKE_QUIT           0x7f
+
+#define BITS_PER_LONG       (sizeof(long) * 8)
+#define NLONGS(n)           (((n) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+
+enum {
+    PROFILE_TOUCH,
+    PROFILE_KEY,
+    PROFILE_WAKE,
+    NUM_PROFILES,
+};
+
+static const char *profile_names[NUM_PROFILES] = {
+    "touch", "key", "wake",
+};
+
+struct profile {
+    unsigned long min_freq;     /* kHz, 0 leaves the frequency alone */
+    int cores;                  /* 0 leaves hotplug alone */
+    int duration_ms;
+};
+
+struct boostd {
+    const char *sysfs;
+    const char *fb_dir;
+    struct profile profiles[NUM_PROFILES];
+    int rate_limit_ms;
+    int verbose;
+
+    int input_fds[MAX_INPUTS];
+    unsigned int input_caps[MAX_INPUTS];    /* 1 << PROFILE_* */
+    int num_inputs;
+    int wake_pipe[2];
+
+    char min_freq_path[PATH_MAX];
+    char online_path[MAX_CPUS][PATH_MAX];
+    unsigned long base_freq;    /* kHz, from the config */
+    char base_min_freq[32];
+
+    int active;                 /* profile in effect, or -1 */
+    long long boost_end;
+};
+
+static int quit_fd = -1;
+
+static long long now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static int write_str(const char *path, const char *s)
+{
+    int fd, ret;
+
+    fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0) {
+        ALOGE("cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+    ret = write(fd, s, strlen(s));
+    if (ret < 0)
+        ALOGE("cannot write %s: %s", path, strerror(errno));
+    close(fd);
+    return ret < 0 ? -1 : 0;
+}
+
+static int read_str(const char *path, char *buf, size_t size)
+{
+    int fd, len;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0)
+        return -1;
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+        len--;
+    buf[len] = '\0';
+    return len;
+}
+
+/*
+ * Config lines are "<profile> <min_freq_khz> <cores> <duration_ms>",
+ * "rate_limit_ms <ms>" or "base_min_freq <khz>"; '#' starts a comment.
+ */
+static int load_config(struct boostd *b, const char *path)
+{
+    char line[256];
+    FILE *f;
+    int lineno = 0;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        ALOGE("cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char name[32];
+        unsigned long freq;
+        int cores, duration, i;
+        char *p = strchr(line, '#');
+
+        lineno++;
+        if (p)
+            *p = '\0';
+        if (sscanf(line, " %31s", name) != 1)
+            continue;
+
+        if (!strcmp(name, "rate_limit_ms")) {
+            if (sscanf(line, " %*s %d", &b->rate_limit_ms) != 1)
+                goto bad;
+            continue;
+        }
+        if (!strcmp(name, "base_min_freq")) {
+            if (sscanf(line, " %*s %lu", &b->base_freq) != 1)
+                goto bad;
+            continue;
+        }
+
+        for (i = 0; i < NUM_PROFILES; i++)
+            if (!strcmp(name, profile_names[i]))
+                break;
+        if (i == NUM_PROFILES ||
+            sscanf(line, " %*s %lu %d %d", &freq, &cores, &duration) != 3 ||
+            cores < 0 || cores > MAX_CPUS || duration < 0)
+            goto bad;
+
+        b->profiles[i].min_freq = freq;
+        b->profiles[i].cores = cores;
+        b->profiles[i].duration_ms = duration;
+    }
+    fclose(f);
+    return 0;
+
+bad:
+    ALOGE("%s:%d: invalid line", path, lineno);
+    fclose(f);
+    return -1;
+}
+
+static int test_bit(int bit, const unsigned long *bits)
+{
+    return (bits[bit / BITS_PER_LONG] >> (bit % BITS_PER_LONG)) & 1;
+}
+
+static int any_bit(int first, int last, const unsigned long *bits)
+{
+    int bit;
+
+    for (bit = first; bit < last; bit++)
+        if (test_bit(bit, bits))
+            return 1;
+    return 0;
+}
+
+/* Which profiles an input device may trigger, from its capabilities. */
+static unsigned int input_caps(int fd)
+{
+    unsigned long ev[NLONGS(EV_CNT)];
+    unsigned long abs[NLONGS(ABS_CNT)];
+    unsigned long key[NLONGS(KEY_CNT)];
+    unsigned long prop[NLONGS(INPUT_PROP_CNT)];
+    unsigned int caps = 0;
+
+    memset(ev, 0, sizeof(ev));
+    memset(abs, 0, sizeof(abs));
+    memset(key, 0, sizeof(key));
+    memset(prop, 0, sizeof(prop));
+
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(ev)), ev) < 0) {
+        /* not an evdev node: a test fake */
+        return 1 << PROFILE_TOUCH | 1 << PROFILE_KEY;
+    }
+    if (test_bit(EV_ABS, ev))
+        ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(abs)), abs);
+    if (test_bit(EV_KEY, ev))
+        ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key)), key);
+    ioctl(fd, EVIOCGPROP(sizeof(prop)), prop);
+
+    if (test_bit(ABS_MT_POSITION_X, abs) || test_bit(BTN_TOUCH, key) ||
+        (test_bit(INPUT_PROP_DIRECT, prop) && test_bit(ABS_X, abs)))
+        caps |= 1 << PROFILE_TOUCH;
+    if (any_bit(KEY_ESC, BTN_MISC, key) || any_bit(KEY_OK, BTN_TRIGGER_HAPPY, key))
+        caps |= 1 << PROFILE_KEY;
+    return caps;
+}
+
+static void open_input(struct boostd *b, const char *path)
+{
+    unsigned int caps;
+    int fd;
+
+    if (b->num_inputs == MAX_INPUTS)
+        return;
+    fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        ALOGE("cannot open %s: %s", path, strerror(errno));
+        return;
+    }
+    caps = input_caps(fd);
+    if (caps == 0) {
+        close(fd);
+        return;
+    }
+    if (b->verbose)
+        ALOGI("%s:%s%s", path, caps & 1 << PROFILE_TOUCH ? " touch" : "",
+              caps & 1 << PROFILE_KEY ? " key" : "");
+    b->input_fds[b->num_inputs] = fd;
+    b->input_caps[b->num_inputs++] = caps;
+}
+
+static void scan_inputs(struct boostd *b)
+{
+    char path[PATH_MAX];
+    struct dirent *de;
+    DIR *dir;
+
+    dir = opendir(INPUT_DIR);
+    if (dir == NULL)
+        return;
+    while ((de = readdir(dir))) {
+        if (strncmp(de->d_name, "event", 5))
+            continue;
+        snprintf(path, sizeof(path), INPUT_DIR "/%s", de->d_name);
+        open_input(b, path);
+    }
+    closedir(dir);
+}
+
+/* Reads block until the display changes state. */
+static int wait_fb(const char *dir, const char *node)
+{
+    char path[PATH_MAX];
+    char buf[16];
+    int fd, ret;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, node);
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ALOGE("cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+    do {
+        ret = read(fd, buf, sizeof(buf));
+    } while (ret < 0 && errno == EINTR);
+    close(fd);
+    return ret < 0 ? -1 : 0;
+}
+
+static void *fb_wake_thread(void *arg)
+{
+    struct boostd *b = arg;
+    char c = PROFILE_WAKE;
+
+    for (;;) {
+        if (wait_fb(b->fb_dir, "wait_for_fb_wake") < 0)
+            break;
+        write(b->wake_pipe[1], &c, 1);
+        if (wait_fb(b->fb_dir, "wait_for_fb_sleep") < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void boost(struct boostd *b, int which)
+{
+    const struct profile *p = &b->profiles[which];
+    long long now = now_ms();
+    char buf[32];
+    int cpu;
+
+    if (p->duration_ms == 0)
+        return;
+
+    /* a boost in effect is extended unless a stronger profile arrives */
+    if (b->active >= 0 &&
+        p->min_freq <= b->profiles[b->active].min_freq &&
+        p->cores <= b->profiles[b->active].cores) {
+        if (now + p->duration_ms > b->boost_end)
+            b->boost_end = now + p->duration_ms;
+        return;
+    }
+
+    /* give the governor a breather before boosting again */
+    if (b->active < 0 && b->boost_end &&
+        now - b->boost_end < b->rate_limit_ms)
+        return;
+
+    if (b->verbose)
+        ALOGI("boost %s: %lu kHz, %d cores, %d ms", profile_names[which],
+              p->min_freq, p->cores, p->duration_ms);
+
+    if (p->min_freq) {
+        snprintf(buf, sizeof(buf), "%lu", p->min_freq);
+        write_str(b->min_freq_path, buf);
+    }
+    for (cpu = 1; cpu < p->cores; cpu++)
+        write_str(b->online_path[cpu], "1");
+
+    if (b->active < 0 || now + p->duration_ms > b->boost_end)
+        b->boost_end = now + p->duration_ms;
+    b->active = which;
+}
+
+static void unboost(struct boostd *b)
+{
+    if (b->verbose)
+        ALOGI("unboost");
+
+    /* extra cores are left to auto_hotplug to take down */
+    if (b->profiles[b->active].min_freq)
+        write_str(b->min_freq_path, b->base_min_freq);
+    b->active = -1;
+}
+
+/*
+ * Returns the profile an input event batch asks for, or -1. caps limits
+ * it to what the device is: a touchscreen's BTN_TOUCH is not a key.
+ */
+static int classify(const struct input_event *ev, int count,
+                    unsigned int caps)
+{
+    int i, which = -1;
+
+    for (i = 0; i < count; i++) {
+        if ((caps & 1 << PROFILE_TOUCH) &&
+            (ev[i].type == EV_ABS ||
+             (ev[i].type == EV_KEY && ev[i].code == BTN_TOUCH)))
+            which = PROFILE_TOUCH;
+        else if ((caps & 1 << PROFILE_KEY) && ev[i].type == EV_KEY &&
+                 ev[i].code != BTN_TOUCH && ev[i].value == 1)
+            return PROFILE_KEY;
+    }
+    return which;
+}
+
+static void quit_handler(int sig)
+{
+    char c = WAKE_QUIT;
+
+    write(quit_fd, &c, 1);
+}
+
+/* Returns 0 when asked to quit, -1 on error. */
+static int run(struct boostd *b)
+{
+    struct pollfd fds[MAX_INPUTS + 1];
+    struct input_event ev[64];
+    int nfds = 0, i;
+
+    for (i = 0; i < b->num_inputs; i++) {
+        fds[nfds].fd = b->input_fds[i];
+        fds[nfds++].events = POLLIN;
+    }
+    fds[nfds].fd = b->wake_pipe[0];
+    fds[nfds++].events = POLLIN;
+
+    for (;;) {
+        int timeout = -1;
+        int which = -1;
+
+        if (b->active >= 0) {
+            long long left = b->boost_end - now_ms();
+            if (left <= 0) {
+                unboost(b);
+                continue;
+            }
+            timeout = left;
+        }
+
+        if (poll(fds, nfds, timeout) < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("poll: %s", strerror(errno));
+            return -1;
+        }
+
+        for (i = 0; i < nfds; i++) {
+            int len;
+
+            if (!(fds[i].revents & POLLIN)) {
+                /* device went away, stop polling it */
+                if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                    close(fds[i].fd);
+                    fds[i].fd = -1;
+                }
+                continue;
+            }
+
+            if (fds[i].fd == b->wake_pipe[0]) {
+                char c;
+                if (read(fds[i].fd, &c, 1) == 1) {
+                    if (c == WAKE_QUIT)
+                        return 0;
+                    which = PROFILE_WAKE;
+                }
+                continue;
+            }
+
+            /* drain the device; one boost covers the whole batch */
+            while ((len = read(fds[i].fd, ev, sizeof(ev))) > 0) {
+                int w = classify(ev, len / sizeof(ev[0]), b->input_caps[i]);
+                if (w >= 0 && (which < 0 || w > which))
+                    which = w;
+            }
+        }
+
+        if (which >= 0)
+            boost(b, which);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-c config] [-r sysfs_root] [-i input]... "
+            "[-w fb_dir] [-v]\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct boostd b;
+    const char *config = DEFAULT_CONFIG;
+    struct sigaction sa;
+    pthread_t thread;
+    int opt, cpu, ret;
+
+    memset(&b, 0, sizeof(b));
+    b.sysfs = DEFAULT_SYSFS;
+    b.rate_limit_ms = 100;
+    b.active = -1;
+
+    /* -i devices are opened after the options, so -v applies to them */
+    while ((opt = getopt(argc, argv, "c:r:i:w:vh")) != -1) {
+        switch (opt) {
+        case 'c': config = optarg; break;
+        case 'r': b.sysfs = optarg; break;
+        case 'i': break;
+        case 'w': b.fb_dir = optarg; break;
+        case 'v': b.verbose = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    optind = 1;
+    while ((opt = getopt(argc, argv, "c:r:i:w:vh")) != -1)
+        if (opt == 'i')
+            open_input(&b, optarg);
+
+    if (load_config(&b, config) < 0)
+        return 1;
+
+    snprintf(b.min_freq_path, sizeof(b.min_freq_path),
+             "%s/devices/system/cpu/cpu0/cpufreq/scaling_min_freq", b.sysfs);
+    for (cpu = 0; cpu < MAX_CPUS; cpu++)
+        snprintf(b.online_path[cpu], sizeof(b.online_path[cpu]),
+                 "%s/devices/system/cpu/cpu%d/online", b.sysfs, cpu);
+    if (b.base_freq) {
+        snprintf(b.base_min_freq, sizeof(b.base_min_freq), "%lu",
+                 b.base_freq);
+    } else {
+        char path[PATH_MAX];
+
+        snprintf(path, sizeof(path),
+                 "%s/devices/system/cpu/cpu0/cpufreq/cpuinfo_min_freq",
+                 b.sysfs);
+        if (read_str(path, b.base_min_freq, sizeof(b.base_min_freq)) <= 0) {
+            ALOGE("cannot read %s", path);
+            return 1;
+        }
+    }
+    /* undo whatever a previous instance left behind */
+    write_str(b.min_freq_path, b.base_min_freq);
+
+    if (b.num_inputs == 0)
+        scan_inputs(&b);
+
+    if (pipe(b.wake_pipe) < 0) {
+        ALOGE("pipe: %s", strerror(errno));
+        return 1;
+    }
+    quit_fd = b.wake_pipe[1];
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = quit_handler;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    if (b.fb_dir == NULL) {
+        static char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/power", b.sysfs);
+        b.fb_dir = path;
+    }
+    if (b.fb_dir[0])
+        pthread_create(&thread, NULL, fb_wake_thread, &b);
+
+    ALOGI("watching %d input devices, min freq %s kHz", b.num_inputs,
+          b.base_min_freq);
+    ret = run(&b);
+
+    write_str(b.min_freq_path, b.base_min_freq);
+    return ret < 0 ? 1 : 0;
+}
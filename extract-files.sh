@@ -4,14 +4,110 @@ VENDOR=lge
 DEVICE=p880
 
 BASE=../../../vendor/$VENDOR/$DEVICE/proprietary
-rm -rf $BASE/*
+MANIFEST=../../../vendor/$VENDOR/$DEVICE/proprietary-files.sha1
 
-for FILE in `cat proprietary-files.txt | grep -v ^# | grep -v ^$`; do
-    DIR=`dirname $FILE`
-    if [ ! -d $BASE/$DIR ]; then
-        mkdir -p $BASE/$DIR
-    fi
-    adb pull /system/$FILE $BASE/$FILE
+usage() {
+    echo "usage: $0 [-d system_dir] [-j jobs] [-f]"
+    echo "  -d dir   copy from a local /system tree or mounted image instead of adb"
+    echo "  -j jobs  parallel copies (default: number of CPUs)"
+    echo "  -f       wipe and extract everything, skipping no blob"
+    exit 1
+}
+
+SRC=""
+JOBS=`getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4`
+FULL=0
+
+while getopts "d:j:f" opt; do
+    case $opt in
+    d) SRC=$OPTARG ;;
+    j) JOBS=$OPTARG ;;
+    f) FULL=1 ;;
+    *) usage ;;
+    esac
 done
 
+if [ -n "$SRC" ] && [ -d "$SRC/system" ]; then
+    SRC=$SRC/system
+fi
+if [ -n "$SRC" ] && [ ! -d "$SRC" ]; then
+    echo "$SRC is not a directory"
+    exit 1
+fi
+
+if which sha1sum >/dev/null 2>&1; then
+    SHA1SUM=sha1sum
+else
+    SHA1SUM="shasum -a 1"
+fi
+
+export LC_ALL=C
+TMP=`mktemp -d`
+trap "rm -rf $TMP" EXIT
+
+cat proprietary-files.txt | grep -v ^# | grep -v ^$ | sort -u > $TMP/files
+
+if [ $FULL = 1 ]; then
+    rm -rf $BASE/*
+fi
+mkdir -p $BASE
+
+# Hashes of the blobs at the source, "<sha1>  <file>" per line. Devices
+# without sha1sum get every blob pulled to a staging area and hashed here.
+if [ -n "$SRC" ]; then
+    (cd $SRC && cat $TMP/files | xargs -P $JOBS -n 32 $SHA1SUM) > $TMP/src.sha1
+    FETCH="cp $SRC/\$1 \$2"
+elif adb shell sha1sum /system/build.prop 2>/dev/null | grep -q '^[0-9a-f]\{40\} '; then
+    adb shell "cd /system && sha1sum `cat $TMP/files | tr '\n' ' '`" | \
+        tr -d '\r' > $TMP/src.sha1
+    FETCH="adb pull /system/\$1 \$2 2>/dev/null"
+else
+    echo "no sha1sum on the device, pulling every blob to compare"
+    mkdir -p $TMP/stage
+    cat $TMP/files | xargs -P $JOBS -I FILE sh -c \
+        'mkdir -p `dirname '$TMP'/stage/FILE` && adb pull /system/FILE '$TMP'/stage/FILE 2>/dev/null'
+    (cd $TMP/stage && cat $TMP/files | xargs -P $JOBS -n 32 $SHA1SUM 2>/dev/null) > $TMP/src.sha1
+    FETCH="cp $TMP/stage/\$1 \$2"
+fi
+grep '^[0-9a-f]\{40\}  ' $TMP/src.sha1 | sort > $TMP/src.sorted
+
+awk '{ print $2 }' $TMP/src.sorted | sort | comm -23 $TMP/files - > $TMP/missing
+if [ -s $TMP/missing ]; then
+    echo "missing at source:"
+    cat $TMP/missing
+    exit 1
+fi
+
+# What is already extracted, hashed so a modified blob is caught too.
+(cd $BASE && cat $TMP/files | xargs -P $JOBS -n 32 $SHA1SUM 2>/dev/null) | \
+    sort > $TMP/dst.sorted
+
+comm -23 $TMP/src.sorted $TMP/dst.sorted | awk '{ print $2 }' > $TMP/todo
+COUNT=`wc -l < $TMP/todo | awk '{ print $1 }'`
+echo "$COUNT of `wc -l < $TMP/files | awk '{ print $1 }'` blobs changed"
+
+if [ $COUNT != 0 ]; then
+    cat $TMP/todo | xargs -P $JOBS -I FILE sh -c \
+        'mkdir -p `dirname '$BASE'/FILE` && set -- FILE '$BASE'/FILE && '"$FETCH"
+
+    # verify what was copied against the source hashes
+    (cd $BASE && cat $TMP/todo | xargs -n 32 $SHA1SUM) | sort > $TMP/copied
+    awk 'NR == FNR { todo[$1]; next } $2 in todo' $TMP/todo $TMP/src.sorted \
+        > $TMP/expected
+    if ! cmp -s $TMP/expected $TMP/copied; then
+        echo "checksum mismatch after copy:"
+        comm -13 $TMP/expected $TMP/copied
+        exit 1
+    fi
+fi
+
+# drop blobs that were extracted before but are no longer listed
+if [ -f $MANIFEST ]; then
+    awk '{ print $2 }' $MANIFEST | sort > $TMP/old
+    for FILE in `comm -23 $TMP/old $TMP/files`; do
+        rm -f $BASE/$FILE
+    done
+fi
+cp $TMP/src.sorted $MANIFEST
+
 ./setup-makefiles.sh
@@ -14,12 +14,16 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include <fcntl.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -37,6 +41,7 @@
 #endif
 
 #include "minui.h"
+#include "recovery-gfx.h"
 
 #if defined(RECOVERY_BGRA)
 #define PIXEL_FORMAT GGL_PIXEL_FORMAT_BGRA_8888
@@ -51,6 +56,11 @@
 
 #define NUM_BUFFERS 2
 
+#define DAMAGE_TILE 32
+
+#define TERM_MAX_COLS 128
+#define TERM_MAX_ROWS 128
+
 typedef struct {
     GGLSurface texture;
     unsigned cwidth;
@@ -69,6 +79,70 @@ static int overscan_percent = OVERSCAN_PERCENT;
 static int overscan_offset_x = 0;
 static int overscan_offset_y = 0;
 
+typedef struct {
+    int x;
+    int y;
+    int cols;
+    int rows;
+    int top;        /* ring index of the oldest visible line */
+    int count;      /* number of lines currently held */
+    unsigned char fg[4];
+    unsigned char bg[4];
+    char text[TERM_MAX_ROWS][TERM_MAX_COLS + 1];
+} GRTerm;
+
+static GRTerm gr_term = {
+    .fg = { 255, 255, 255, 255 },
+    .bg = { 0, 0, 0, 255 },
+};
+
+/*
+ * Damage tracking. Every drawing call folds a fingerprint of itself (what,
+ * where, which color or surface) into each DAMAGE_TILE sized tile it
+ * touches. Drawing is deterministic, so a tile whose calls start with an
+ * opaque fill covering all of it, and whose fingerprint matches the one
+ * that produced its current content, holds the same pixels as before.
+ * gr_flip() skips the copy and the pan when every touched tile matches.
+ * No pixels are read for this.
+ */
+enum {
+    TILE_UNTOUCHED,
+    TILE_COVERED,       /* first call was an opaque fill over all of it */
+    TILE_UNKNOWN,       /* result depends on what was there before */
+};
+
+enum {
+    OP_OPAQUE,          /* overwrites what it covers */
+    OP_BLEND,           /* blends with what it covers */
+    OP_RAW,             /* pixels moved or written outside of the ops */
+};
+
+static unsigned char *gr_tile_state = 0;
+static uint64_t *gr_tile_fp = 0;        /* calls since the last check */
+static uint64_t *gr_tile_last = 0;      /* calls behind the content, or 0 */
+static unsigned gr_tiles_x = 0;
+static unsigned gr_tiles_y = 0;
+static bool gr_frame_changed = true;
+static unsigned gr_flips_skipped = 0;
+static unsigned char gr_cur_color[4];
+
+/* last frame sent by gr_capture_delta(), and its output buffer */
+static unsigned char *gr_capture_prev = 0;
+static unsigned char *gr_capture_buf = 0;
+static unsigned gr_capture_seq = 0;
+
+/* gr_init() phase durations in microseconds, reported by gr_exit() */
+static struct {
+    uint64_t start;
+    uint64_t ggl;
+    uint64_t font;
+    uint64_t tty;
+    uint64_t fb;
+    uint64_t surface;
+    uint64_t backlight;
+    uint64_t first_frame;   /* from gr_init() entry to the first gr_flip() */
+} gr_init_time;
+
 static int gr_fb_fd = -1;
 static int gr_vt_fd = -1;
 
@@ -165,7 +239,8 @@ static int get_framebuffer(GGLSurface *fb)
     fb->stride = fi.line_length/PIXEL_SIZE;
     fb->data = (void*) (((unsigned) bits) + vi.yres * fi.line_length);
     fb->format = PIXEL_FORMAT;
-    memset(fb->data, 0, vi.yres * fi.line_length);
+    /* no need to clear it: gr_flip() copies a whole frame in before it
+     * is first shown */
 
     return fd;
 }
@@ -179,6 +254,149 @@ static void get_memory_surface(GGLSurface* ms) {
     ms->format = PIXEL_FORMAT;
 }
 
+static uint64_t gr_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#define FNV_OFFSET  0xcbf29ce484222325ULL
+#define FNV_PRIME   0x100000001b3ULL
+
+static uint64_t gr_fnv(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+
+    while (len--)
+        hash = (hash ^ *p++) * FNV_PRIME;
+    return hash;
+}
+
+static void gr_damage_init(void)
+{
+    unsigned n;
+
+    gr_tiles_x = (vi.xres + DAMAGE_TILE - 1) / DAMAGE_TILE;
+    gr_tiles_y = (vi.yres + DAMAGE_TILE - 1) / DAMAGE_TILE;
+    n = gr_tiles_x * gr_tiles_y;
+    gr_tile_state = calloc(n, 1);
+    gr_tile_fp = malloc(n * sizeof(*gr_tile_fp));
+    gr_tile_last = calloc(n, sizeof(*gr_tile_last));
+    if (gr_tile_state == NULL || gr_tile_fp == NULL || gr_tile_last == NULL) {
+        /* without them every flip goes through */
+        free(gr_tile_state);
+        free(gr_tile_fp);
+        free(gr_tile_last);
+        gr_tile_state = NULL;
+        gr_tile_fp = NULL;
+        gr_tile_last = NULL;
+    }
+    gr_frame_changed = true;
+}
+
+/*
+ * Record a drawing call over [x1, x2) x [y1, y2) of the shadow surface.
+ * op fingerprints the call; two calls that draw differently must differ.
+ */
+static void gr_damage(int x1, int y1, int x2, int y2, int kind, uint64_t op)
+{
+    int tx, ty;
+
+    if (gr_tile_state == NULL)
+        return;
+    if (x1 < 0)
+        x1 = 0;
+    if (y1 < 0)
+        y1 = 0;
+    if (x2 > (int) vi.xres)
+        x2 = vi.xres;
+    if (y2 > (int) vi.yres)
+        y2 = vi.yres;
+    if (x1 >= x2 || y1 >= y2)
+        return;
+
+    for (ty = y1 / DAMAGE_TILE; ty <= (y2 - 1) / DAMAGE_TILE; ty++) {
+        for (tx = x1 / DAMAGE_TILE; tx <= (x2 - 1) / DAMAGE_TILE; tx++) {
+            unsigned i = ty * gr_tiles_x + tx;
+
+            if (kind == OP_RAW) {
+                gr_tile_state[i] = TILE_UNKNOWN;
+                continue;
+            }
+            if (gr_tile_state[i] == TILE_UNTOUCHED) {
+                int covered = kind == OP_OPAQUE &&
+                    x1 <= tx * DAMAGE_TILE && y1 <= ty * DAMAGE_TILE &&
+                    (x2 >= (tx + 1) * DAMAGE_TILE || x2 == (int) vi.xres) &&
+                    (y2 >= (ty + 1) * DAMAGE_TILE || y2 == (int) vi.yres);
+                gr_tile_state[i] = covered ? TILE_COVERED : TILE_UNKNOWN;
+                gr_tile_fp[i] = FNV_OFFSET;
+            }
+            gr_tile_fp[i] = (gr_tile_fp[i] ^ op) * FNV_PRIME;
+        }
+    }
+}
+
+/* Fingerprint of a drawing call, for gr_damage(). */
+static uint64_t gr_op(int what, const void *surface, int x1, int y1,
+                      int x2, int y2, int sx, int sy, uint64_t text)
+{
+    struct {
+        int what;
+        const void *surface;
+        int rect[6];
+        unsigned char color[4];
+        uint64_t text;
+    } op;
+
+    /* hashed as bytes, so clear the padding too */
+    memset(&op, 0, sizeof(op));
+    op.what = what;
+    op.surface = surface;
+    op.rect[0] = x1;
+    op.rect[1] = y1;
+    op.rect[2] = x2;
+    op.rect[3] = y2;
+    op.rect[4] = sx;
+    op.rect[5] = sy;
+    memcpy(op.color, gr_cur_color, sizeof(op.color));
+    op.text = text;
+    return gr_fnv(FNV_OFFSET, &op, sizeof(op));
+}
+
+/* Decide from the calls since the last check whether the frame changed. */
+static void gr_damage_update(void)
+{
+    unsigned i, n = gr_tiles_x * gr_tiles_y;
+
+    if (gr_tile_state == NULL) {
+        gr_frame_changed = true;
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        if (gr_tile_state[i] == TILE_UNTOUCHED)
+            continue;
+        if (gr_tile_state[i] != TILE_COVERED ||
+            gr_tile_fp[i] != gr_tile_last[i])
+            gr_frame_changed = true;
+        /* content that depends on history cannot be matched later */
+        gr_tile_last[i] = gr_tile_state[i] == TILE_COVERED ? gr_tile_fp[i] : 0;
+        gr_tile_state[i] = TILE_UNTOUCHED;
+    }
+}
+
+int gr_flip_pending(void)
+{
+    gr_damage_update();
+    return gr_frame_changed;
+}
+
+unsigned gr_flip_skipped(void)
+{
+    return gr_flips_skipped;
+}
+
 static void set_active_framebuffer(unsigned n)
 {
     if (n > 1 || !double_buffering) return;
@@ -194,6 +412,13 @@ void gr_flip(void)
 {
     GGLContext *gl = gr_context;
 
+    gr_damage_update();
+    if (!gr_frame_changed) {
+        gr_flips_skipped++;
+        return;
+    }
+    gr_frame_changed = false;
+
     /* swap front and back buffers */
     if (double_buffering)
         gr_active_fb = (gr_active_fb + 1) & 1;
@@ -205,6 +430,9 @@ void gr_flip(void)
 
     /* inform the display driver */
     set_active_framebuffer(gr_active_fb);
+
+    if (gr_init_time.first_frame == 0 && gr_init_time.start != 0)
+        gr_init_time.first_frame = gr_now_us() - gr_init_time.start;
 }
 
 void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
@@ -216,6 +444,11 @@ void gr_color(unsigned char r, unsigned char g, unsigned char b, unsigned char a
     color[2] = ((b << 8) | b) + 1;
     color[3] = ((a << 8) | a) + 1;
     gl->color4xv(gl, color);
+
+    gr_cur_color[0] = r;
+    gr_cur_color[1] = g;
+    gr_cur_color[2] = b;
+    gr_cur_color[3] = a;
 }
 
 int gr_measure(const char *s)
@@ -233,7 +466,9 @@ int gr_text(int x, int y, const char *s)
 {
     GGLContext *gl = gr_context;
     GRFont *font = gr_font;
+    const char *text = s;
     unsigned off;
+    int x0;
 
     x += overscan_offset_x;
     y += overscan_offset_y;
@@ -246,6 +481,7 @@ int gr_text(int x, int y, const char *s)
     gl->texGeni(gl, GGL_T, GGL_TEXTURE_GEN_MODE, GGL_ONE_TO_ONE);
     gl->enable(gl, GGL_TEXTURE_2D);
 
+    x0 = x;
     while((off = *s++)) {
         off -= 32;
         if (off < 96) {
@@ -254,6 +490,9 @@ int gr_text(int x, int y, const char *s)
         }
         x += font->cwidth;
     }
+    gr_damage(x0, y, x, y + font->cheight, OP_BLEND,
+              gr_op('T', font, x0, y, 0, 0, 0, 0,
+                    gr_fnv(FNV_OFFSET, text, s - text - 1)));
 
     return x;
 }
@@ -278,6 +517,8 @@ void gr_texticon(int x, int y, gr_surface icon) {
 
     gl->texCoord2i(gl, -x, -y);
     gl->recti(gl, x, y, x+gr_get_width(icon), y+gr_get_height(icon));
+    gr_damage(x, y, x + w, y + h, OP_BLEND,
+              gr_op('I', icon, x, y, x + w, y + h, 0, 0, 0));
 }
 
 void gr_fill(int x1, int y1, int x2, int y2)
@@ -291,6 +532,8 @@ void gr_fill(int x1, int y1, int x2, int y2)
     GGLContext *gl = gr_context;
     gl->disable(gl, GGL_TEXTURE_2D);
     gl->recti(gl, x1, y1, x2, y2);
+    gr_damage(x1, y1, x2, y2, gr_cur_color[3] == 255 ? OP_OPAQUE : OP_BLEND,
+              gr_op('F', NULL, x1, y1, x2, y2, 0, 0, 0));
 }
 
 void gr_blit(gr_surface source, int sx, int sy, int w, int h, int dx, int dy) {
@@ -309,6 +552,8 @@ void gr_blit(gr_surface source, int sx, int sy, int w, int h, int dx, int dy) {
     gl->enable(gl, GGL_TEXTURE_2D);
     gl->texCoord2i(gl, sx - dx, sy - dy);
     gl->recti(gl, dx, dy, dx + w, dy + h);
+    gr_damage(dx, dy, dx + w, dy + h, OP_BLEND,
+              gr_op('B', source, dx, dy, dx + w, dy + h, sx, sy, 0));
 }
 
 unsigned int gr_get_width(gr_surface surface) {
@@ -325,6 +570,140 @@ unsigned int gr_get_height(gr_surface surface) {
     return ((GGLSurface*) surface)->height;
 }
 
+static void gr_term_draw_row(int row)
+{
+    GRTerm *t = &gr_term;
+    int y = t->y + row * gr_font->cheight;
+
+    gr_color(t->bg[0], t->bg[1], t->bg[2], t->bg[3]);
+    gr_fill(t->x, y, t->x + t->cols * gr_font->cwidth, y + gr_font->cheight);
+
+    if (row < t->count) {
+        gr_color(t->fg[0], t->fg[1], t->fg[2], t->fg[3]);
+        gr_text(t->x, y + gr_font->ascent,
+                t->text[(t->top + row) % t->rows]);
+    }
+}
+
+/*
+ * Move the rendered terminal rows up by n lines in the shadow surface.
+ * Returns -1 if they could not be moved and the terminal must be redrawn.
+ */
+static int gr_term_scroll(int n)
+{
+    GRTerm *t = &gr_term;
+    unsigned char *base = gr_mem_surface.data;
+    int px = t->x + overscan_offset_x;
+    int py = t->y + overscan_offset_y;
+    int w = t->cols * gr_font->cwidth;
+    int h = t->rows * gr_font->cheight;
+    int dy = n * gr_font->cheight;
+    int y;
+
+    if (px < 0 || py < 0 || dy >= h)
+        return -1;
+    if (px + w > (int) vi.xres)
+        w = vi.xres - px;
+    if (py + h > (int) vi.yres)
+        h = vi.yres - py;
+    if (w <= 0 || h <= dy)
+        return -1;
+
+    base += py * fi.line_length + px * PIXEL_SIZE;
+    if (px == 0 && w == (int) vi.xres) {
+        /* full width: the rows are contiguous, move them in one go */
+        memmove(base, base + dy * fi.line_length, (h - dy) * fi.line_length);
+    } else {
+        for (y = 0; y < h - dy; y++) {
+            memmove(base + y * fi.line_length,
+                    base + (y + dy) * fi.line_length, w * PIXEL_SIZE);
+        }
+    }
+    gr_damage(px, py, px + w, py + h - dy, OP_RAW, 0);
+    return 0;
+}
+
+void gr_term_init(int x, int y, int cols, int rows)
+{
+    GRTerm *t = &gr_term;
+
+    if (cols > TERM_MAX_COLS)
+        cols = TERM_MAX_COLS;
+    if (rows > TERM_MAX_ROWS)
+        rows = TERM_MAX_ROWS;
+
+    t->x = x;
+    t->y = y;
+    t->cols = cols > 0 ? cols : 0;
+    t->rows = rows > 0 ? rows : 0;
+    t->top = 0;
+    t->count = 0;
+}
+
+void gr_term_colors(const unsigned char fg[4], const unsigned char bg[4])
+{
+    memcpy(gr_term.fg, fg, sizeof(gr_term.fg));
+    memcpy(gr_term.bg, bg, sizeof(gr_term.bg));
+}
+
+void gr_term_puts(const char *s)
+{
+    GRTerm *t = &gr_term;
+    int added = 0;
+    int scrolled = 0;
+    int row;
+
+    if (gr_context == NULL || t->rows == 0)
+        return;
+
+    do {
+        const char *end = strchr(s, '\n');
+        int len = end ? end - s : (int) strlen(s);
+        char *line;
+
+        if (t->count < t->rows) {
+            line = t->text[(t->top + t->count++) % t->rows];
+        } else {
+            line = t->text[t->top];
+            t->top = (t->top + 1) % t->rows;
+            scrolled++;
+        }
+        if (len > t->cols)
+            len = t->cols;
+        memcpy(line, s, len);
+        line[len] = '\0';
+        added++;
+
+        s = end ? end + 1 : NULL;
+    } while (s != NULL && *s != '\0');
+
+    if (added >= t->rows || (scrolled && gr_term_scroll(scrolled) < 0)) {
+        gr_term_redraw();
+        return;
+    }
+
+    /* what is already rendered has moved up; draw only the new lines */
+    for (row = t->count - added; row < t->count; row++)
+        gr_term_draw_row(row);
+}
+
+void gr_term_clear(void)
+{
+    gr_term.top = 0;
+    gr_term.count = 0;
+    gr_term_redraw();
+}
+
+void gr_term_redraw(void)
+{
+    int row;
+
+    if (gr_context == NULL)
+        return;
+    for (row = 0; row < gr_term.rows; row++)
+        gr_term_draw_row(row);
+}
+
 static void gr_init_font(void)
 {
     GGLSurface *ftex;
@@ -356,10 +735,20 @@ static void gr_init_font(void)
 
 int gr_init(void)
 {
+    uint64_t t;
+
+    memset(&gr_init_time, 0, sizeof(gr_init_time));
+    gr_init_time.start = t = gr_now_us();
+
     gglInit(&gr_context);
     GGLContext *gl = gr_context;
+    gr_init_time.ggl = gr_now_us() - t;
 
+    t = gr_now_us();
     gr_init_font();
+    gr_init_time.font = gr_now_us() - t;
+
+    t = gr_now_us();
     gr_vt_fd = open("/dev/tty0", O_RDWR | O_SYNC);
     if (gr_vt_fd < 0) {
         // This is non-fatal; post-Cupcake kernels don't have tty0.
@@ -370,14 +759,20 @@ int gr_init(void)
         gr_exit();
         return -1;
     }
+    gr_init_time.tty = gr_now_us() - t;
 
+    t = gr_now_us();
     gr_fb_fd = get_framebuffer(gr_framebuffer);
     if (gr_fb_fd < 0) {
         gr_exit();
         return -1;
     }
+    gr_init_time.fb = gr_now_us() - t;
 
+    t = gr_now_us();
     get_memory_surface(&gr_mem_surface);
+    gr_damage_init();
+    gr_init_time.surface = gr_now_us() - t;
 
     fprintf(stderr, "framebuffer: fd %d (%d x %d)\n",
             gr_fb_fd, gr_framebuffer[0].width, gr_framebuffer[0].height);
@@ -391,18 +786,44 @@ int gr_init(void)
     gl->enable(gl, GGL_BLEND);
     gl->blendFunc(gl, GGL_SRC_ALPHA, GGL_ONE_MINUS_SRC_ALPHA);
 
-    gr_fb_blank(true);
+    /* the backlight is all gr_fb_blank() controls, so there is nothing
+     * to reset by blanking first */
+    t = gr_now_us();
     gr_fb_blank(false);
+    gr_init_time.backlight = gr_now_us() - t;
 
     return 0;
 }
 
 void gr_exit(void)
 {
+    if (gr_init_time.start != 0) {
+        fprintf(stderr, "gr_init: ggl %llu us, tty %llu us, fb %llu us, "
+                "surface %llu us, backlight %llu us, font %llu us, "
+                "first frame after %llu us\n",
+                (unsigned long long) gr_init_time.ggl,
+                (unsigned long long) gr_init_time.tty,
+                (unsigned long long) gr_init_time.fb,
+                (unsigned long long) gr_init_time.surface,
+                (unsigned long long) gr_init_time.backlight,
+                (unsigned long long) gr_init_time.font,
+                (unsigned long long) gr_init_time.first_frame);
+        gr_init_time.start = 0;
+    }
+
     close(gr_fb_fd);
     gr_fb_fd = -1;
 
     free(gr_mem_surface.data);
+    free(gr_tile_state);
+    free(gr_tile_fp);
+    free(gr_tile_last);
+    gr_tile_state = NULL;
+    gr_tile_fp = NULL;
+    gr_tile_last = NULL;
+    gr_capture_reset();
+    free(gr_capture_buf);
+    gr_capture_buf = NULL;
 
     ioctl(gr_vt_fd, KDSETMODE, (void*) KD_TEXT);
     close(gr_vt_fd);
@@ -421,7 +842,143 @@ int gr_fb_height(void)
 
 gr_pixel *gr_fb_data(void)
 {
-    return (unsigned short *) gr_mem_surface.data;
+    /* the caller may write anywhere before the next flip */
+    gr_damage(0, 0, vi.xres, vi.yres, OP_RAW, 0);
+    return (gr_pixel *) gr_mem_surface.data;
+}
+
+int gr_capture(gr_frame *frame)
+{
+    if (gr_mem_surface.data == NULL)
+        return -1;
+
+    frame->width = vi.xres;
+    frame->height = vi.yres;
+    frame->stride = fi.line_length;
+    frame->pixel_size = PIXEL_SIZE;
+    frame->format = PIXEL_FORMAT;
+    frame->data = gr_mem_surface.data;
+    return 0;
+}
+
+void gr_capture_reset(void)
+{
+    free(gr_capture_prev);
+    gr_capture_prev = NULL;
+}
+
+static int write_all(int fd, const unsigned char *p, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int gr_capture_delta(int fd)
+{
+    const unsigned tile = GR_CAPTURE_TILE;
+    const unsigned char *cur = gr_mem_surface.data;
+    unsigned tiles_x = (vi.xres + tile - 1) / tile;
+    unsigned tiles_y = (vi.yres + tile - 1) / tile;
+    size_t frame_len = fi.line_length * vi.yres;
+    unsigned char *out, *p;
+    uint32_t count = 0;
+    unsigned tx, ty, y;
+    int full = 0;
+
+    if (cur == NULL)
+        return -1;
+
+    if (gr_capture_buf == NULL) {
+        /* worst case: every tile, each with its 8 byte header */
+        gr_capture_buf = malloc(20 + tiles_x * tiles_y * 8 +
+                                vi.xres * vi.yres * PIXEL_SIZE);
+        if (gr_capture_buf == NULL)
+            return -1;
+    }
+    if (gr_capture_prev == NULL) {
+        gr_capture_prev = malloc(frame_len);
+        if (gr_capture_prev == NULL)
+            return -1;
+        full = 1;
+    }
+
+    out = gr_capture_buf + 20;
+    for (ty = 0; ty < tiles_y; ty++) {
+        for (tx = 0; tx < tiles_x; tx++) {
+            uint16_t hdr[4];
+            unsigned x0 = tx * tile, y0 = ty * tile;
+            unsigned w = vi.xres - x0 < tile ? vi.xres - x0 : tile;
+            unsigned h = vi.yres - y0 < tile ? vi.yres - y0 : tile;
+            size_t off = y0 * fi.line_length + x0 * PIXEL_SIZE;
+            size_t row = w * PIXEL_SIZE;
+
+            if (!full) {
+                for (y = 0; y < h; y++) {
+                    size_t o = off + y * fi.line_length;
+                    if (memcmp(cur + o, gr_capture_prev + o, row))
+                        break;
+                }
+                if (y == h)
+                    continue;
+            }
+
+            hdr[0] = x0;
+            hdr[1] = y0;
+            hdr[2] = w;
+            hdr[3] = h;
+            memcpy(out, hdr, sizeof(hdr));
+            out += sizeof(hdr);
+            for (y = 0; y < h; y++) {
+                memcpy(out, cur + off + y * fi.line_length, row);
+                out += row;
+            }
+            count++;
+        }
+    }
+
+    {
+        uint32_t magic = GR_CAPTURE_MAGIC, seq = gr_capture_seq++;
+        uint16_t dims[2] = { vi.xres, vi.yres };
+        uint8_t fmt[2] = { PIXEL_FORMAT, PIXEL_SIZE };
+        uint16_t tsize = tile;
+
+        p = gr_capture_buf;
+        memcpy(p, &magic, 4);
+        memcpy(p + 4, &seq, 4);
+        memcpy(p + 8, dims, 4);
+        memcpy(p + 12, fmt, 2);
+        memcpy(p + 14, &tsize, 2);
+        memcpy(p + 16, &count, 4);
+    }
+
+    if (write_all(fd, gr_capture_buf, out - gr_capture_buf) < 0) {
+        /* the receiver may have got part of it: start over in full */
+        gr_capture_reset();
+        return -1;
+    }
+
+    /* only now is it safe to diff the next frame against these tiles */
+    for (p = gr_capture_buf + 20; p < out; ) {
+        uint16_t hdr[4];
+        size_t off, row;
+
+        memcpy(hdr, p, sizeof(hdr));
+        off = hdr[1] * fi.line_length + hdr[0] * PIXEL_SIZE;
+        row = hdr[2] * PIXEL_SIZE;
+        for (y = 0; y < hdr[3]; y++, off += fi.line_length)
+            memcpy(gr_capture_prev + off, cur + off, row);
+        p += sizeof(hdr) + hdr[3] * row;
+    }
+    return count;
 }
 
 void gr_fb_blank(bool blank)
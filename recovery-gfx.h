@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _RECOVERY_GFX_H_
+#define _RECOVERY_GFX_H_
+
+/*
+ * Device specific extensions to the minui graphics API implemented in
+ * recovery-gfx.c. Everything declared in minui.h is still available.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Scrolling log terminal. The terminal occupies cols x rows character
+ * cells with its top-left corner at (x, y), in the same coordinates as
+ * gr_text(). Appending a line to a full terminal moves the rendered rows
+ * up inside the shadow surface and draws only the new line, so each line
+ * costs the same no matter how many are on screen. Drawing leaves the
+ * current color set to the terminal foreground. When the rendered rows
+ * cannot be moved, e.g. the terminal is partly off screen, the whole
+ * terminal is redrawn instead.
+ */
+void gr_term_init(int x, int y, int cols, int rows);
+void gr_term_colors(const unsigned char fg[4], const unsigned char bg[4]);
+void gr_term_puts(const char *s);
+void gr_term_clear(void);
+void gr_term_redraw(void);
+
+/*
+ * Frame capture. gr_capture() describes the shadow surface, i.e. what the
+ * next gr_flip() puts on screen, including the overscan border. data is
+ * width x height pixels of pixel_size bytes in the given GGL format, with
+ * rows stride bytes apart.
+ *
+ * gr_fb_data() from minui.h returns the same memory as gr_pixel, which is
+ * 16 bits wide whatever the pixel format; RECOVERY_BGRA and RECOVERY_RGBX
+ * builds should use gr_capture() instead.
+ */
+typedef struct {
+    unsigned width;
+    unsigned height;
+    unsigned stride;
+    unsigned pixel_size;
+    int format;
+    const void *data;
+} gr_frame;
+
+int gr_capture(gr_frame *frame);
+
+/*
+ * Delta-encoded capture stream. Each call to gr_capture_delta() writes
+ * one frame record to fd, in host byte order:
+ *
+ *   u32 magic ('GRFD')   u32 sequence
+ *   u16 width            u16 height
+ *   u8  format           u8  pixel_size     u16 tile size
+ *   u32 number of tiles that follow
+ *
+ * and for each tile that changed since the previous call:
+ *
+ *   u16 x  u16 y  u16 w  u16 h   then w * h pixels, row by row
+ *
+ * The first call, and the first one after gr_capture_reset(), sends
+ * every tile. Returns the number of tiles written or -1 on error.
+ */
+#define GR_CAPTURE_MAGIC    0x44465247
+#define GR_CAPTURE_TILE     32
+
+int gr_capture_delta(int fd);
+void gr_capture_reset(void);
+
+/*
+ * Idle frames. Drawing calls fingerprint themselves into the screen tiles
+ * they touch, and gr_flip() does not copy or flip a frame drawn with the
+ * same calls as the one on screen. This holds for tiles that a frame
+ * starts by filling with an opaque color, as a full redraw does; other
+ * tiles count as changed whenever they are drawn to. Surfaces passed to
+ * gr_blit() and gr_texticon() are recognised by address, so one that is
+ * modified in place must be drawn into a tile that changes anyway.
+ *
+ * gr_flip_pending() returns nonzero if what has been drawn since the last
+ * flip would change the screen. It can only answer once the frame has
+ * been drawn, so it saves the flip, not the rendering.
+ * gr_flip_skipped() returns the number of flips skipped so far.
+ *
+ * Pixels written through gr_fb_data() are not fingerprinted: every call
+ * to it marks the whole frame as changed. Callers that write directly
+ * must call it again for every frame they draw, rather than keeping the
+ * pointer, or their frames will not be flipped.
+ */
+int gr_flip_pending(void);
+unsigned gr_flip_skipped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,11 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := alsa_latency
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := alsa_latency.c
+LOCAL_C_INCLUDES := external/alsa-lib/include
+LOCAL_SHARED_LIBRARIES := libasound
+
+include $(BUILD_EXECUTABLE)
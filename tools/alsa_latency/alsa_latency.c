@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Round-trip latency and xrun benchmark for the PCM definitions in
+ * asound.conf.
+ *
+ * A pulse is written to the playback PCM and the capture PCM is scanned
+ * until it comes back; the distance between the two, in frames, is the
+ * round-trip latency. Underruns and overruns are counted for the whole
+ * run. With "-C none" only playback is exercised, which is enough to
+ * check a period/buffer configuration against snd-dummy.
+ *
+ * The plug routes in asound.conf do not fix period or buffer sizes; as a
+ * client of pcm.lowlatency has to, the tool requests 240 frame periods
+ * and a 960 frame buffer, or what -p and -b say. The capture PCM runs at
+ * the same period size.
+ *
+ * Latency is counted from the moment the pulse is written, so it
+ * includes everything queued ahead of it. By default the whole buffer is
+ * kept full, as an app that fills its buffer would.
+ *
+ * It builds on any Linux host with alsa-lib:
+ *
+ *   gcc -O2 -o alsa_latency alsa_latency.c -lasound
+ *   modprobe snd-aloop
+ *   ./alsa_latency -f configs/asound.conf \
+ *       -f tools/alsa_latency/host-loopback.conf \
+ *       -P lowlatency -C hw:Loopback,1,0
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <alsa/asoundlib.h>
+
+#define FORMAT          SND_PCM_FORMAT_S16_LE
+#define MAX_CONFIGS     8
+#define PULSE_FRAMES    16
+#define PULSE_LEVEL     16000
+#define DETECT_LEVEL    8000
+
+struct bench {
+    const char *play_name;
+    const char *capt_name;
+    const char *configs[MAX_CONFIGS];
+    int num_configs;
+    unsigned int rate;
+    unsigned int channels;
+    snd_pcm_uframes_t period;
+    snd_pcm_uframes_t buffer;
+    unsigned int prefill;
+    unsigned int seconds;
+
+    snd_config_t *top;
+    snd_pcm_t *play;
+    snd_pcm_t *capt;
+    int linked;
+    short *buf;
+
+    unsigned long underruns;
+    unsigned long overruns;
+    unsigned long pulses;
+    unsigned long lost;
+    long lat_min;
+    long lat_max;
+    long long lat_sum;
+};
+
+static int load_configs(struct bench *b)
+{
+    snd_input_t *in;
+    int i, err;
+
+    err = snd_config_update();
+    if (err < 0)
+        return err;
+    err = snd_config_copy(&b->top, snd_config);
+    if (err < 0)
+        return err;
+
+    /* later files override earlier ones */
+    for (i = 0; i < b->num_configs; i++) {
+        err = snd_input_stdio_open(&in, b->configs[i], "r");
+        if (err < 0) {
+            fprintf(stderr, "cannot open %s: %s\n", b->configs[i],
+                    snd_strerror(err));
+            return err;
+        }
+        err = snd_config_load(b->top, in);
+        snd_input_close(in);
+        if (err < 0) {
+            fprintf(stderr, "cannot parse %s: %s\n", b->configs[i],
+                    snd_strerror(err));
+            return err;
+        }
+    }
+    return 0;
+}
+
+static int set_params(struct bench *b, snd_pcm_t *pcm)
+{
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_sw_params_t *sw;
+    snd_pcm_uframes_t period = b->period;
+    snd_pcm_uframes_t buffer = b->buffer;
+    snd_pcm_uframes_t boundary;
+    int dir = 0;
+    unsigned int rate = b->rate;
+    int err;
+
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_sw_params_alloca(&sw);
+
+    if ((err = snd_pcm_hw_params_any(pcm, hw)) < 0 ||
+        (err = snd_pcm_hw_params_set_access(pcm, hw,
+                SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(pcm, hw, FORMAT)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(pcm, hw, b->channels)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, 0)) < 0 ||
+        (b->period && (err = snd_pcm_hw_params_set_period_size_near(pcm,
+                hw, &period, 0)) < 0) ||
+        (b->buffer && (err = snd_pcm_hw_params_set_buffer_size_near(pcm,
+                hw, &buffer)) < 0) ||
+        (err = snd_pcm_hw_params(pcm, hw)) < 0 ||
+        (err = snd_pcm_hw_params_get_period_size(hw, &period, &dir)) < 0 ||
+        (err = snd_pcm_hw_params_get_buffer_size(hw, &buffer)) < 0) {
+        fprintf(stderr, "%s: hw params: %s\n", snd_pcm_name(pcm),
+                snd_strerror(err));
+        return err;
+    }
+
+    /* nothing forced: take what the PCM definition chose */
+    if (b->period == 0)
+        b->period = period;
+    if (b->buffer == 0)
+        b->buffer = buffer;
+
+    if (rate != b->rate || period != b->period || buffer != b->buffer) {
+        fprintf(stderr, "%s: got rate %u period %lu buffer %lu\n",
+                snd_pcm_name(pcm), rate, period, buffer);
+        if (rate != b->rate || period != b->period)
+            return -EINVAL;
+    }
+
+    /* streams are started explicitly once playback is prefilled */
+    if ((err = snd_pcm_sw_params_current(pcm, sw)) < 0 ||
+        (err = snd_pcm_sw_params_get_boundary(sw, &boundary)) < 0 ||
+        (err = snd_pcm_sw_params_set_avail_min(pcm, sw, period)) < 0 ||
+        (err = snd_pcm_sw_params_set_start_threshold(pcm, sw,
+                boundary)) < 0 ||
+        (err = snd_pcm_sw_params(pcm, sw)) < 0) {
+        fprintf(stderr, "%s: sw params: %s\n", snd_pcm_name(pcm),
+                snd_strerror(err));
+        return err;
+    }
+    return 0;
+}
+
+static int open_pcm(struct bench *b, snd_pcm_t **pcm, const char *name,
+                    snd_pcm_stream_t stream)
+{
+    int err;
+
+    err = snd_pcm_open_lconf(pcm, name, stream, 0, b->top);
+    if (err < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", name, snd_strerror(err));
+        return err;
+    }
+    return set_params(b, *pcm);
+}
+
+/* Prepare both streams, prefill playback with silence and start them. */
+static int start_streams(struct bench *b)
+{
+    unsigned int i;
+    int err;
+
+    snd_pcm_drop(b->play);
+    if ((err = snd_pcm_prepare(b->play)) < 0)
+        return err;
+    if (b->capt && !b->linked) {
+        snd_pcm_drop(b->capt);
+        if ((err = snd_pcm_prepare(b->capt)) < 0)
+            return err;
+    }
+
+    memset(b->buf, 0, b->period * b->channels * sizeof(short));
+    for (i = 0; i < b->prefill; i++) {
+        err = snd_pcm_writei(b->play, b->buf, b->period);
+        if (err < 0)
+            return err;
+    }
+
+    if (b->capt && b->linked)
+        return snd_pcm_start(b->capt);
+    if ((err = snd_pcm_start(b->play)) < 0)
+        return err;
+    return b->capt ? snd_pcm_start(b->capt) : 0;
+}
+
+static long find_pulse(struct bench *b)
+{
+    snd_pcm_uframes_t i;
+
+    for (i = 0; i < b->period; i++) {
+        int v = b->buf[i * b->channels];
+        if (v > DETECT_LEVEL || v < -DETECT_LEVEL)
+            return i;
+    }
+    return -1;
+}
+
+static int run(struct bench *b)
+{
+    unsigned long long total = (unsigned long long) b->rate * b->seconds;
+    unsigned long long pos = 0;
+    unsigned long long next_pulse = b->rate / 4;
+    unsigned long long sent = 0;
+    int waiting = 0;
+    snd_pcm_sframes_t n;
+    int err;
+
+    if ((err = start_streams(b)) < 0)
+        return err;
+
+    while (pos < total) {
+        if (b->capt) {
+            n = snd_pcm_readi(b->capt, b->buf, b->period);
+            if (n == -EPIPE) {
+                b->overruns++;
+                goto xrun;
+            } else if (n < 0) {
+                fprintf(stderr, "read: %s\n", snd_strerror(n));
+                return n;
+            }
+
+            if (waiting) {
+                long off = find_pulse(b);
+                if (off >= 0) {
+                    long lat = (long) (pos + off - sent);
+                    if (b->pulses == 0 || lat < b->lat_min)
+                        b->lat_min = lat;
+                    if (lat > b->lat_max)
+                        b->lat_max = lat;
+                    b->lat_sum += lat;
+                    b->pulses++;
+                    waiting = 0;
+                } else if (pos > sent + b->rate) {
+                    b->lost++;
+                    waiting = 0;
+                }
+            }
+        }
+
+        memset(b->buf, 0, b->period * b->channels * sizeof(short));
+        if (b->capt && !waiting && pos >= next_pulse) {
+            unsigned int i;
+            for (i = 0; i < PULSE_FRAMES * b->channels; i++)
+                b->buf[i] = PULSE_LEVEL;
+            /* measured from the write, so the queued periods count */
+            sent = pos;
+            next_pulse = pos + b->rate / 4;
+            waiting = 1;
+        }
+
+        n = snd_pcm_writei(b->play, b->buf, b->period);
+        if (n == -EPIPE) {
+            b->underruns++;
+            goto xrun;
+        } else if (n < 0) {
+            fprintf(stderr, "write: %s\n", snd_strerror(n));
+            return n;
+        }
+
+        pos += b->period;
+        continue;
+xrun:
+        /* restart both streams so the frame counters stay aligned */
+        if (waiting)
+            b->lost++;
+        waiting = 0;
+        total -= pos < total ? pos : total;
+        pos = 0;
+        next_pulse = b->rate / 4;
+        if ((err = start_streams(b)) < 0)
+            return err;
+    }
+    return 0;
+}
+
+static void report(struct bench *b)
+{
+    double ms = 1000.0 / b->rate;
+
+    printf("playback %s, capture %s\n", b->play_name,
+           b->capt ? b->capt_name : "none");
+    printf("rate %u, channels %u, period %lu, buffer %lu, prefill %u\n",
+           b->rate, b->channels, b->period, b->buffer, b->prefill);
+    if (b->capt) {
+        if (b->pulses) {
+            long avg = (long) (b->lat_sum / b->pulses);
+            printf("round trip: min %ld (%.2f ms) avg %ld (%.2f ms) "
+                   "max %ld (%.2f ms) frames over %lu pulses\n",
+                   b->lat_min, b->lat_min * ms, avg, avg * ms,
+                   b->lat_max, b->lat_max * ms, b->pulses);
+        } else {
+            printf("round trip: no pulse came back\n");
+        }
+        printf("lost pulses: %lu\n", b->lost);
+    }
+    printf("underruns: %lu, overruns: %lu\n", b->underruns, b->overruns);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -P pcm     playback PCM (default lowlatency)\n"
+            "  -C pcm     capture PCM, or \"none\" (default hw:Loopback,1,0)\n"
+            "  -f file    load an extra ALSA config, may be repeated\n"
+            "  -r rate    sample rate (default 48000)\n"
+            "  -c count   channels (default 2)\n"
+            "  -p frames  period size to request (default 240), 0 to take\n"
+            "             what the PCM picks\n"
+            "  -b frames  buffer size to request (default 4 periods)\n"
+            "  -k count   periods kept queued (default: the whole buffer)\n"
+            "  -d secs    duration (default 10)\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct bench b;
+    int opt, err;
+
+    memset(&b, 0, sizeof(b));
+    b.play_name = "lowlatency";
+    b.capt_name = "hw:Loopback,1,0";
+    b.rate = 48000;
+    b.channels = 2;
+    b.period = 240;
+    b.seconds = 10;
+
+    while ((opt = getopt(argc, argv, "P:C:f:r:c:p:b:k:d:h")) != -1) {
+        switch (opt) {
+        case 'P': b.play_name = optarg; break;
+        case 'C': b.capt_name = optarg; break;
+        case 'f':
+            if (b.num_configs == MAX_CONFIGS) {
+                fprintf(stderr, "too many config files\n");
+                return 1;
+            }
+            b.configs[b.num_configs++] = optarg;
+            break;
+        case 'r': b.rate = atoi(optarg); break;
+        case 'c': b.channels = atoi(optarg); break;
+        case 'p': b.period = atoi(optarg); break;
+        case 'b': b.buffer = atoi(optarg); break;
+        case 'k': b.prefill = atoi(optarg); break;
+        case 'd': b.seconds = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (b.period && b.buffer == 0)
+        b.buffer = b.period * 4;
+    if (!b.rate || !b.channels) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (load_configs(&b) < 0)
+        return 1;
+    if (open_pcm(&b, &b.play, b.play_name, SND_PCM_STREAM_PLAYBACK) < 0)
+        return 1;
+    if (b.prefill == 0)
+        b.prefill = b.buffer / b.period;
+    if (b.prefill == 0 || b.prefill * b.period > b.buffer) {
+        fprintf(stderr, "prefill of %u periods does not fit a %lu frame "
+                "buffer\n", b.prefill, b.buffer);
+        return 1;
+    }
+
+    b.buf = malloc(b.period * b.channels * sizeof(short));
+    if (b.buf == NULL)
+        return 1;
+    if (strcmp(b.capt_name, "none") &&
+        open_pcm(&b, &b.capt, b.capt_name, SND_PCM_STREAM_CAPTURE) < 0)
+        return 1;
+    if (b.capt)
+        b.linked = snd_pcm_link(b.capt, b.play) == 0;
+
+    err = run(&b);
+    report(&b);
+
+    if (b.capt)
+        snd_pcm_close(b.capt);
+    snd_pcm_close(b.play);
+    snd_config_delete(b.top);
+    free(b.buf);
+
+    return err < 0 ? 1 : 0;
+}
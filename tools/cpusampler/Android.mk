@@ -0,0 +1,17 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := cpusampler
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := cpusampler.c
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := cpusampler2csv
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := cpusampler2csv.c
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * CPU frequency, hotplug and idle telemetry sampler.
+ *
+ * Samples cpufreq time_in_state, the interactive governor's cores_states,
+ * the online CPU mask and cpuidle state counters into a binary ring log
+ * (see cpusampler.h, cpusampler2csv converts it). Every sysfs node is
+ * opened once and re-read with a single pread() per sample, records are
+ * batched in memory and written with one pwrite() per batch, and the
+ * per-state idle counters, the most numerous nodes, are refreshed only
+ * every -I samples.
+ *
+ *   cpusampler [-r sysfs_root] [-o log] [-f hz] [-n capacity]
+ *              [-b batch] [-I idle_every] [-d seconds]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cpusampler.h"
+
+#define DEFAULT_LOG     "/data/local/tmp/cpusampler.log"
+#define CPU_DIR         "devices/system/cpu"
+#define IDLE_USAGE      CPU_DIR "/cpu%d/cpuidle/state%d/usage"
+#define IDLE_TIME       CPU_DIR "/cpu%d/cpuidle/state%d/time"
+
+struct sampler {
+    const char *root;
+    const char *log;
+    unsigned int hz;
+    unsigned int capacity;
+    unsigned int batch;
+    unsigned int idle_every;
+    unsigned int seconds;
+
+    int tis_fd;
+    int cores_fd;
+    int online_fd;
+    int idle_usage_fd[CPUS_MAX_CPUS][CPUS_MAX_IDLE];
+    int idle_time_fd[CPUS_MAX_CPUS][CPUS_MAX_IDLE];
+    int log_fd;
+
+    struct cpus_header hdr;
+    struct cpus_record last;
+    struct cpus_record *pending;
+    unsigned int num_pending;
+};
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    stop = 1;
+}
+
+static int open_node(const char *root, const char *fmt, int a, int b)
+{
+    char rel[PATH_MAX], path[PATH_MAX];
+
+    snprintf(rel, sizeof(rel), fmt, a, b);
+    snprintf(path, sizeof(path), "%s/%s", root, rel);
+    return open(path, O_RDONLY);
+}
+
+/* One syscall per node: sysfs regenerates the contents at offset 0. */
+static int read_node(int fd, char *buf, size_t size)
+{
+    ssize_t len;
+
+    if (fd < 0)
+        return -1;
+    len = pread(fd, buf, size - 1, 0);
+    if (len < 0)
+        return -1;
+    buf[len] = '\0';
+    return len;
+}
+
+/* "0-1,3" style CPU lists, as in /sys/devices/system/cpu/online */
+static uint32_t parse_cpulist(const char *s)
+{
+    uint32_t mask = 0;
+    char *end;
+
+    while (*s) {
+        long a = strtol(s, &end, 10), b;
+        if (end == s)
+            break;
+        b = a;
+        if (*end == '-')
+            b = strtol(end + 1, &end, 10);
+        for (; a <= b && a < 32; a++)
+            mask |= 1u << a;
+        s = *end == ',' ? end + 1 : end;
+        if (*s == '\n')
+            break;
+    }
+    return mask;
+}
+
+static void sample_time_in_state(struct sampler *s, struct cpus_record *r,
+                                 int learn)
+{
+    char buf[1024];
+    char *p = buf;
+    unsigned int i = 0;
+
+    if (read_node(s->tis_fd, buf, sizeof(buf)) < 0)
+        return;
+
+    while (*p && i < CPUS_MAX_FREQS) {
+        char *end;
+        unsigned long freq = strtoul(p, &end, 10);
+        unsigned long t;
+
+        if (end == p)
+            break;
+        t = strtoul(end, &p, 10);
+        if (learn)
+            s->hdr.freqs[i] = freq;
+        else if (s->hdr.freqs[i] != freq)
+            break;      /* table changed under us, keep the old layout */
+        r->time_in_state[i++] = t;
+        while (*p == '\n' || *p == ' ')
+            p++;
+    }
+    if (learn)
+        s->hdr.num_freqs = i;
+}
+
+static void sample_cores_states(struct sampler *s, struct cpus_record *r,
+                                int learn)
+{
+    char buf[512];
+    char *p = buf;
+    unsigned int i = 0;
+
+    if (read_node(s->cores_fd, buf, sizeof(buf)) < 0)
+        return;
+
+    while (*p && i < CPUS_MAX_CORES) {
+        char *end;
+        unsigned long v = strtoul(p, &end, 10);
+
+        if (end == p) {
+            p++;
+            continue;
+        }
+        r->cores_states[i++] = v;
+        p = end;
+    }
+    if (learn)
+        s->hdr.num_cores_states = i;
+}
+
+/*
+ * cpuidle directories are removed while a CPU is offline, so a failed
+ * read drops the descriptor and the node is reopened on a later pass.
+ */
+static int read_idle_node(struct sampler *s, int *fd, const char *fmt,
+                          int cpu, int st, char *buf, size_t size)
+{
+    if (*fd < 0)
+        *fd = open_node(s->root, fmt, cpu, st);
+    if (read_node(*fd, buf, size) > 0)
+        return 0;
+    if (*fd >= 0)
+        close(*fd);
+    *fd = -1;
+    return -1;
+}
+
+static void sample_idle(struct sampler *s, struct cpus_record *r)
+{
+    char buf[32];
+    unsigned int cpu, st;
+
+    for (cpu = 0; cpu < s->hdr.num_cpus; cpu++) {
+        for (st = 0; st < s->hdr.num_idle_states; st++) {
+            struct cpus_idle *idle = &r->idle[cpu][st];
+
+            if (read_idle_node(s, &s->idle_usage_fd[cpu][st], IDLE_USAGE,
+                               cpu, st, buf, sizeof(buf)) == 0)
+                idle->usage = strtoul(buf, NULL, 10);
+            if (read_idle_node(s, &s->idle_time_fd[cpu][st], IDLE_TIME,
+                               cpu, st, buf, sizeof(buf)) == 0)
+                idle->time_us = strtoull(buf, NULL, 10);
+        }
+    }
+}
+
+static void sample(struct sampler *s, struct cpus_record *r,
+                   unsigned long long n)
+{
+    struct timespec ts;
+    char buf[64];
+
+    /* start from the previous record so skipped fields carry over */
+    *r = s->last;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    r->timestamp_ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+    if (read_node(s->online_fd, buf, sizeof(buf)) > 0)
+        r->online_mask = parse_cpulist(buf);
+    sample_time_in_state(s, r, 0);
+    sample_cores_states(s, r, 0);
+    if (n % s->idle_every == 0)
+        sample_idle(s, r);
+
+    s->last = *r;
+}
+
+static int write_header(struct sampler *s)
+{
+    if (pwrite(s->log_fd, &s->hdr, sizeof(s->hdr), 0) != sizeof(s->hdr)) {
+        perror("cannot write log header");
+        return -1;
+    }
+    return 0;
+}
+
+static int flush(struct sampler *s)
+{
+    unsigned int done = 0;
+
+    while (done < s->num_pending) {
+        uint64_t index = s->hdr.count + done;
+        unsigned int slot = index % s->hdr.capacity;
+        unsigned int n = s->num_pending - done;
+        off_t off = sizeof(s->hdr) + (off_t) slot * sizeof(struct cpus_record);
+        size_t len;
+
+        /* split the batch where it wraps around the ring */
+        if (slot + n > s->hdr.capacity)
+            n = s->hdr.capacity - slot;
+        len = n * sizeof(struct cpus_record);
+        if (pwrite(s->log_fd, s->pending + done, len, off) != (ssize_t) len) {
+            perror("cannot write log");
+            return -1;
+        }
+        done += n;
+    }
+
+    s->hdr.count += s->num_pending;
+    s->num_pending = 0;
+    return write_header(s);
+}
+
+static int setup(struct sampler *s)
+{
+    unsigned int cpu, st;
+    char buf[64];
+    int fd;
+
+    s->tis_fd = open_node(s->root, CPU_DIR "/cpu0/cpufreq/stats/time_in_state",
+                          0, 0);
+    s->cores_fd = open_node(s->root, CPU_DIR "/cpufreq/interactive/cores_states",
+                            0, 0);
+    s->online_fd = open_node(s->root, CPU_DIR "/online", 0, 0);
+    if (s->tis_fd < 0)
+        fprintf(stderr, "no time_in_state, frequencies not sampled\n");
+    if (s->online_fd < 0)
+        fprintf(stderr, "no online mask, hotplug not sampled\n");
+
+    /* every possible CPU, offline ones are picked up once they come back */
+    s->hdr.num_cpus = CPUS_MAX_CPUS;
+    fd = open_node(s->root, CPU_DIR "/possible", 0, 0);
+    if (read_node(fd, buf, sizeof(buf)) > 0) {
+        uint32_t possible = parse_cpulist(buf);
+        for (cpu = CPUS_MAX_CPUS; cpu > 1 && !(possible >> (cpu - 1)); cpu--)
+            ;
+        s->hdr.num_cpus = cpu;
+    }
+    if (fd >= 0)
+        close(fd);
+    for (cpu = 0; cpu < s->hdr.num_cpus; cpu++) {
+        for (st = 0; st < CPUS_MAX_IDLE; st++) {
+            s->idle_usage_fd[cpu][st] = open_node(s->root, IDLE_USAGE,
+                                                  cpu, st);
+            s->idle_time_fd[cpu][st] = open_node(s->root, IDLE_TIME, cpu, st);
+            if (s->idle_usage_fd[cpu][st] >= 0 &&
+                st + 1 > s->hdr.num_idle_states)
+                s->hdr.num_idle_states = st + 1;
+        }
+    }
+
+    s->hdr.magic = CPUS_MAGIC;
+    s->hdr.version = CPUS_VERSION;
+    s->hdr.header_size = sizeof(s->hdr);
+    s->hdr.record_size = sizeof(struct cpus_record);
+    s->hdr.capacity = s->capacity;
+    s->hdr.interval_us = 1000000 / s->hz;
+    s->hdr.idle_every = s->idle_every;
+    sample_time_in_state(s, &s->last, 1);
+    sample_cores_states(s, &s->last, 1);
+
+    s->pending = calloc(s->batch, sizeof(struct cpus_record));
+    if (s->pending == NULL)
+        return -1;
+
+    s->log_fd = open(s->log, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (s->log_fd < 0) {
+        fprintf(stderr, "cannot open %s: %s\n", s->log, strerror(errno));
+        return -1;
+    }
+    return write_header(s);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -r root    sysfs root (default /sys)\n"
+            "  -o file    log file (default " DEFAULT_LOG ")\n"
+            "  -f hz      sample rate (default 100)\n"
+            "  -n count   ring capacity in records (default 30000)\n"
+            "  -b count   records per write (default 100)\n"
+            "  -I count   read idle stats every n samples (default 10)\n"
+            "  -d secs    stop after this long (default: until signalled)\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct sampler s;
+    struct timespec next;
+    unsigned long long n;
+    long interval_ns;
+    int opt;
+
+    memset(&s, 0, sizeof(s));
+    s.root = "/sys";
+    s.log = DEFAULT_LOG;
+    s.hz = 100;
+    s.capacity = 30000;
+    s.batch = 100;
+    s.idle_every = 10;
+
+    while ((opt = getopt(argc, argv, "r:o:f:n:b:I:d:h")) != -1) {
+        switch (opt) {
+        case 'r': s.root = optarg; break;
+        case 'o': s.log = optarg; break;
+        case 'f': s.hz = atoi(optarg); break;
+        case 'n': s.capacity = atoi(optarg); break;
+        case 'b': s.batch = atoi(optarg); break;
+        case 'I': s.idle_every = atoi(optarg); break;
+        case 'd': s.seconds = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (!s.hz || s.hz > 10000 || !s.capacity || !s.batch || !s.idle_every) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (s.batch > s.capacity)
+        s.batch = s.capacity;
+
+    if (setup(&s) < 0)
+        return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    interval_ns = 1000000000L / s.hz;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for (n = 0; !stop; n++) {
+        if (s.seconds && n >= (unsigned long long) s.seconds * s.hz)
+            break;
+
+        sample(&s, &s.pending[s.num_pending++], n);
+        if (s.num_pending == s.batch && flush(&s) < 0)
+            return 1;
+
+        /* absolute deadlines so the rate does not drift with load */
+        next.tv_nsec += interval_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next,
+                               NULL) == EINTR && !stop)
+            ;
+    }
+
+    if (flush(&s) < 0)
+        return 1;
+    close(s.log_fd);
+    return 0;
+}
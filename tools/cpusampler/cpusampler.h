@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CPUSAMPLER_H_
+#define _CPUSAMPLER_H_
+
+#include <stdint.h>
+
+/*
+ * On-disk format shared by cpusampler and cpusampler2csv.
+ *
+ * The log is a header followed by a ring of fixed size records. Record
+ * i lives in slot (i % capacity); the header's count is the number of
+ * records ever written, so the oldest surviving record is
+ * max(0, count - capacity). All fields are little endian.
+ */
+
+#define CPUS_MAGIC          0x53555043  /* "CPUS" */
+#define CPUS_VERSION        1
+
+#define CPUS_MAX_CPUS       4
+#define CPUS_MAX_FREQS      24
+#define CPUS_MAX_CORES      8
+#define CPUS_MAX_IDLE       4
+
+struct cpus_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint32_t interval_us;
+    uint32_t idle_every;        /* idle stats refreshed every n samples */
+    uint32_t num_cpus;
+    uint32_t num_freqs;
+    uint32_t num_cores_states;
+    uint32_t num_idle_states;
+    uint32_t reserved;
+    uint64_t count;
+    uint32_t freqs[CPUS_MAX_FREQS];     /* kHz, order of time_in_state */
+};
+
+struct cpus_idle {
+    uint32_t usage;
+    uint32_t reserved;
+    uint64_t time_us;
+};
+
+struct cpus_record {
+    uint64_t timestamp_ns;      /* CLOCK_MONOTONIC */
+    uint32_t online_mask;
+    uint32_t reserved;
+    uint32_t time_in_state[CPUS_MAX_FREQS];     /* 10 ms units */
+    uint32_t cores_states[CPUS_MAX_CORES];      /* first integers found */
+    struct cpus_idle idle[CPUS_MAX_CPUS][CPUS_MAX_IDLE];
+};
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Converts a cpusampler ring log to CSV, oldest record first.
+ *
+ *   cpusampler2csv [-d] log > out.csv
+ *
+ * Counters are cumulative as read from sysfs; -d prints the change since
+ * the previous record instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpusampler.h"
+
+static int bitcount(uint32_t v)
+{
+    int n = 0;
+
+    for (; v; v &= v - 1)
+        n++;
+    return n;
+}
+
+static void print_header(const struct cpus_header *h)
+{
+    unsigned int i, cpu, st;
+
+    printf("time_s,online_mask,online");
+    for (i = 0; i < h->num_freqs; i++)
+        printf(",tis_%u", h->freqs[i]);
+    for (i = 0; i < h->num_cores_states; i++)
+        printf(",cores_states_%u", i);
+    for (cpu = 0; cpu < h->num_cpus; cpu++)
+        for (st = 0; st < h->num_idle_states; st++)
+            printf(",cpu%u_state%u_usage,cpu%u_state%u_time_us",
+                   cpu, st, cpu, st);
+    printf("\n");
+}
+
+static void print_record(const struct cpus_header *h,
+                         const struct cpus_record *r,
+                         const struct cpus_record *prev, uint64_t t0)
+{
+    unsigned int i, cpu, st;
+
+    printf("%.6f,0x%x,%d", (r->timestamp_ns - t0) / 1e9, r->online_mask,
+           bitcount(r->online_mask));
+    for (i = 0; i < h->num_freqs; i++)
+        printf(",%u", r->time_in_state[i] -
+               (prev ? prev->time_in_state[i] : 0));
+    for (i = 0; i < h->num_cores_states; i++)
+        printf(",%u", r->cores_states[i]);
+    for (cpu = 0; cpu < h->num_cpus; cpu++) {
+        for (st = 0; st < h->num_idle_states; st++) {
+            const struct cpus_idle *idle = &r->idle[cpu][st];
+            const struct cpus_idle *old = prev ? &prev->idle[cpu][st] : NULL;
+
+            printf(",%u,%llu", idle->usage - (old ? old->usage : 0),
+                   (unsigned long long) (idle->time_us -
+                                         (old ? old->time_us : 0)));
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    struct cpus_header h;
+    struct cpus_record r, prev;
+    uint64_t first, n, t0 = 0;
+    int deltas = 0;
+    FILE *f;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "dh")) != -1) {
+        switch (opt) {
+        case 'd': deltas = 1; break;
+        default:
+            fprintf(stderr, "usage: %s [-d] log\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-d] log\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[optind], "rb");
+    if (f == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (fread(&h, sizeof(h), 1, f) != 1 || h.magic != CPUS_MAGIC) {
+        fprintf(stderr, "%s: not a cpusampler log\n", argv[optind]);
+        return 1;
+    }
+    if (h.version != CPUS_VERSION || h.header_size != sizeof(h) ||
+        h.record_size != sizeof(r) || h.capacity == 0 ||
+        h.num_cpus > CPUS_MAX_CPUS || h.num_freqs > CPUS_MAX_FREQS ||
+        h.num_cores_states > CPUS_MAX_CORES ||
+        h.num_idle_states > CPUS_MAX_IDLE) {
+        fprintf(stderr, "%s: unsupported log layout\n", argv[optind]);
+        return 1;
+    }
+
+    print_header(&h);
+
+    first = h.count > h.capacity ? h.count - h.capacity : 0;
+    for (n = first; n < h.count; n++) {
+        long off = sizeof(h) + (long) (n % h.capacity) * sizeof(r);
+
+        if (fseek(f, off, SEEK_SET) < 0 || fread(&r, sizeof(r), 1, f) != 1) {
+            fprintf(stderr, "%s: truncated log\n", argv[optind]);
+            return 1;
+        }
+        if (n == first)
+            t0 = r.timestamp_ns;
+        print_record(&h, &r, deltas && n != first ? &prev : NULL, t0);
+        prev = r;
+    }
+
+    fclose(f);
+    return 0;
+}
@@ -0,0 +1,9 @@
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := storage_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SRC_FILES := storage_bench.c
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,137 @@
+#!/bin/sh
+#
+# Runs storage_bench against loop-mounted ext4 images, once per mount
+# option set taken from fstab.x3 and once per read-ahead setting, so the
+# cost of the options we ship can be compared with plain defaults.
+#
+# usage: run-fstab.sh [-f fstab] [-m "mount points"] [-r "read_ahead_kb"]
+#                     [-o name=options]... [-s image_mb] [-t image_dir]
+#
+#   -m  fstab mount points to take options from (default "/data /cache")
+#   -r  read-ahead values to try (default "128 2048"; init.x3.rc uses 2048)
+#   -o  extra option set to compare, may be repeated
+#   -t  where the images live; put this on the storage under test, as a
+#       tmpfs backed image only measures the page cache
+#
+# Needs root, mkfs.ext4 and losetup. Set BENCH to the storage_bench
+# binary if it is not next to this script.
+#
+# Options the running kernel ignores are flagged with a "# WARNING" line
+# taken from the kernel log; current kernels drop nomblk_io_submit, for
+# instance. Results for such options only mean something on a host
+# booted with a kernel that still implements them, such as the 3.x
+# series the handset runs. The script does not run on the handset, which
+# has neither mkfs.ext4 nor losetup.
+
+DIR=`dirname $0`
+FSTAB=$DIR/../../fstab.x3
+MOUNTS="/data /cache"
+READAHEAD="128 2048"
+EXTRA=""
+SIZE_MB=1024
+IMGDIR=/tmp
+BENCH=${BENCH:-$DIR/storage_bench}
+
+while getopts "f:m:r:o:s:t:" opt; do
+    case $opt in
+    f) FSTAB=$OPTARG ;;
+    m) MOUNTS=$OPTARG ;;
+    r) READAHEAD=$OPTARG ;;
+    o) EXTRA="$EXTRA $OPTARG" ;;
+    s) SIZE_MB=$OPTARG ;;
+    t) IMGDIR=$OPTARG ;;
+    *) sed -n '3,24p' $0; exit 1 ;;
+    esac
+done
+
+if [ ! -x "$BENCH" ]; then
+    echo "storage_bench not found, build it or set BENCH" >&2
+    exit 1
+fi
+
+IMG=$IMGDIR/storage_bench.img
+MNT=$IMGDIR/storage_bench.mnt
+LOOP=""
+
+cleanup() {
+    umount $MNT 2>/dev/null
+    [ -n "$LOOP" ] && losetup -d $LOOP 2>/dev/null
+    rm -rf $IMG $MNT
+}
+trap cleanup EXIT INT TERM
+
+# name=options pairs: the shipped sets from fstab, plus ext4 defaults
+SETS="ext4-defaults=defaults"
+for MP in $MOUNTS; do
+    OPTS=`awk -v mp=$MP '$2 == mp && $3 == "ext4" { print $4 }' $FSTAB`
+    if [ -z "$OPTS" ]; then
+        echo "no ext4 entry for $MP in $FSTAB" >&2
+        continue
+    fi
+    SETS="$SETS fstab$MP=$OPTS"
+done
+SETS="$SETS $EXTRA"
+
+# Put a marker in the kernel log before a mount, so check_dropped sees
+# only what was logged after it, even once the log buffer has wrapped.
+KSEQ=0
+mark_klog() {
+    KSEQ=`expr $KSEQ + 1`
+    KMARK="run-fstab.sh[$$] mount $KSEQ"
+    echo "$KMARK" > /dev/kmsg 2>/dev/null || KMARK=""
+}
+
+# Report mount options the kernel logged as ignored or unknown during the
+# mount that just happened.
+check_dropped() {
+    LOG=`dmesg 2>/dev/null | awk -v m="$KMARK" \
+        'found; m != "" && index($0, m) { found = 1 } END { if (!found) print "NOMARK" }'`
+    if [ "$LOG" = NOMARK ] || [ -z "$KMARK" ]; then
+        echo "# WARNING $1: cannot mark or read the kernel log, dropped" \
+             "options are not detected"
+        return
+    fi
+    echo "$LOG" | grep -i 'ignoring\|unrecognized\|removed\|deprecated' | \
+        sed "s/^\[[ 0-9.]*\] //; s|^|# WARNING $1: |"
+}
+
+run_set() {
+    NAME=$1
+    OPTS=$2
+    RA=$3
+
+    rm -f $IMG
+    dd if=/dev/zero of=$IMG bs=1048576 count=0 seek=$SIZE_MB 2>/dev/null
+    mkfs.ext4 -q -F $IMG || return 1
+    LOOP=`losetup -f --show $IMG` || return 1
+    mkdir -p $MNT
+    mark_klog
+    if ! mount -t ext4 -o $OPTS $LOOP $MNT; then
+        echo "$NAME: mount -o $OPTS failed, skipped" >&2
+        losetup -d $LOOP
+        LOOP=""
+        return 1
+    fi
+    check_dropped $NAME
+    echo $RA > /sys/block/`basename $LOOP`/queue/read_ahead_kb
+
+    for W in install sqlite mediascan seqread; do
+        mkdir $MNT/$W
+        echo "$NAME ra=$RA `$BENCH -w $W -d $MNT/$W`"
+        rm -rf $MNT/$W
+    done
+
+    umount $MNT
+    losetup -d $LOOP
+    LOOP=""
+}
+
+echo "# $FSTAB, ${SIZE_MB} MB images in $IMGDIR"
+for SET in $SETS; do
+    NAME=${SET%%=*}
+    OPTS=${SET#*=}
+    echo "# $NAME: $OPTS"
+    for RA in $READAHEAD; do
+        run_set $NAME $OPTS $RA
+    done
+done
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2013 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays Android-like I/O patterns in a directory and reports
+ * throughput and latency percentiles:
+ *
+ *   install    write an apk and its odex, fsync, rename into place
+ *   sqlite     rollback-journal transactions: journal write + fsync,
+ *              random page writes + fsync, journal delete
+ *   mediascan  walk a tree of media files, stat, read head and tail
+ *   seqread    large file read in small chunks, so read-ahead matters
+ *
+ *   storage_bench -w workload -d dir [-s size_mb] [-n count]
+ *
+ * One result line is printed per run, in the format run-fstab.sh
+ * collects. Page cache is dropped between setup and the measured phase,
+ * and throughput counts only the time spent in measured operations.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define CHUNK           (64 * 1024)
+#define PAGE            4096
+#define SEQ_READ        (16 * 1024)
+#define MEDIA_DIRS      20
+
+struct stats {
+    double *lat_us;
+    unsigned int count;
+    unsigned int max;
+    unsigned long long bytes;
+    double busy;                /* seconds spent inside measured ops */
+};
+
+static char buf[CHUNK];
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void die(const char *what)
+{
+    fprintf(stderr, "storage_bench: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+static void record(struct stats *st, double start)
+{
+    if (st->count == st->max) {
+        st->max = st->max ? st->max * 2 : 1024;
+        st->lat_us = realloc(st->lat_us, st->max * sizeof(double));
+        if (st->lat_us == NULL)
+            die("realloc");
+    }
+    st->lat_us[st->count] = (now() - start) * 1e6;
+    st->busy += st->lat_us[st->count++] / 1e6;
+}
+
+static void write_file(const char *path, size_t size, int do_fsync)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0)
+        die(path);
+    while (size) {
+        size_t n = size < CHUNK ? size : CHUNK;
+        if (write(fd, buf, n) != (ssize_t) n)
+            die(path);
+        size -= n;
+    }
+    if (do_fsync && fsync(fd) < 0)
+        die(path);
+    close(fd);
+}
+
+/* Evict what setup left in the page cache. */
+static void drop_cache(const char *path)
+{
+    int fd;
+
+    sync();
+    fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if (fd >= 0) {
+        write(fd, "3", 1);
+        close(fd);
+        return;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static void run_install(const char *dir, unsigned int count, size_t size,
+                        struct stats *st)
+{
+    char tmp[PATH_MAX], apk[PATH_MAX], odex[PATH_MAX];
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        double t = now();
+
+        /* PackageManager copies to a temp name, then renames */
+        snprintf(tmp, sizeof(tmp), "%s/vmdl%u.tmp", dir, i);
+        snprintf(apk, sizeof(apk), "%s/app%u.apk", dir, i);
+        snprintf(odex, sizeof(odex), "%s/app%u.odex", dir, i);
+        write_file(tmp, size, 1);
+        if (rename(tmp, apk) < 0)
+            die(apk);
+        write_file(odex, size / 2, 1);
+        record(st, t);
+        st->bytes += size + size / 2;
+    }
+}
+
+static void run_sqlite(const char *dir, unsigned int count, size_t size,
+                       struct stats *st)
+{
+    char db[PATH_MAX], journal[PATH_MAX];
+    unsigned int pages = size / PAGE;
+    unsigned int i, j;
+    int fd, jfd;
+
+    snprintf(db, sizeof(db), "%s/test.db", dir);
+    snprintf(journal, sizeof(journal), "%s/test.db-journal", dir);
+    write_file(db, size, 1);
+
+    fd = open(db, O_RDWR);
+    if (fd < 0)
+        die(db);
+    srand(1);
+
+    for (i = 0; i < count; i++) {
+        unsigned int dirty = 1 + rand() % 8;
+        double t = now();
+
+        /* original pages go to the journal first */
+        jfd = open(journal, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (jfd < 0)
+            die(journal);
+        for (j = 0; j <= dirty; j++)
+            if (write(jfd, buf, PAGE) != PAGE)
+                die(journal);
+        if (fsync(jfd) < 0)
+            die(journal);
+        close(jfd);
+
+        for (j = 0; j < dirty; j++) {
+            off_t off = (off_t) (rand() % pages) * PAGE;
+            if (pwrite(fd, buf, PAGE, off) != PAGE)
+                die(db);
+        }
+        if (fsync(fd) < 0)
+            die(db);
+        if (unlink(journal) < 0)
+            die(journal);
+
+        record(st, t);
+        st->bytes += (2 * dirty + 1) * PAGE;
+    }
+    close(fd);
+}
+
+static void run_mediascan(const char *dir, unsigned int count, size_t size,
+                          struct stats *st)
+{
+    char path[PATH_MAX];
+    unsigned int i, d;
+
+    for (d = 0; d < MEDIA_DIRS; d++) {
+        snprintf(path, sizeof(path), "%s/DCIM%u", dir, d);
+        mkdir(path, 0755);
+    }
+    for (i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/DCIM%u/IMG_%04u.jpg", dir,
+                 i % MEDIA_DIRS, i);
+        write_file(path, size, 0);
+    }
+    drop_cache(dir);
+
+    for (d = 0; d < MEDIA_DIRS; d++) {
+        struct dirent *de;
+        DIR *dp;
+
+        snprintf(path, sizeof(path), "%s/DCIM%u", dir, d);
+        dp = opendir(path);
+        if (dp == NULL)
+            die(path);
+
+        while ((de = readdir(dp))) {
+            char file[PATH_MAX];
+            struct stat sb;
+            double t;
+            int fd;
+            ssize_t n;
+
+            if (de->d_name[0] == '.')
+                continue;
+            t = now();
+            snprintf(file, sizeof(file), "%s/%s", path, de->d_name);
+            if (stat(file, &sb) < 0)
+                die(file);
+            fd = open(file, O_RDONLY);
+            if (fd < 0)
+                die(file);
+
+            /* EXIF/ID3 header and trailing index, like the scanner */
+            n = pread(fd, buf, CHUNK, 0);
+            if (sb.st_size > CHUNK)
+                n += pread(fd, buf, CHUNK / 4, sb.st_size - CHUNK / 4);
+            close(fd);
+
+            record(st, t);
+            st->bytes += n > 0 ? n : 0;
+        }
+        closedir(dp);
+    }
+}
+
+static void run_seqread(const char *dir, unsigned int count, size_t size,
+                        struct stats *st)
+{
+    char path[PATH_MAX];
+    unsigned int i;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/movie.mp4", dir);
+    write_file(path, size, 1);
+
+    for (i = 0; i < count; i++) {
+        ssize_t n;
+
+        drop_cache(path);
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+            die(path);
+        for (;;) {
+            double t = now();
+            n = read(fd, buf, SEQ_READ);
+            if (n <= 0)
+                break;
+            record(st, t);
+            st->bytes += n;
+        }
+        if (n < 0)
+            die(path);
+        close(fd);
+    }
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const struct stats *st, double p)
+{
+    unsigned int i = p * (st->count - 1) + 0.5;
+
+    return st->lat_us[i];
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s -w workload -d dir [-s size_mb] [-n count]\n"
+            "  workloads: install sqlite mediascan seqread\n"
+            "  -s  apk size, database size, media file size (in KB for\n"
+            "      mediascan) or movie size; defaults 8, 4, 256, 128\n"
+            "  -n  installs, transactions, media files or read passes;\n"
+            "      defaults 20, 500, 1000, 3\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    const char *workload = NULL, *dir = NULL;
+    unsigned int size = 0, count = 0;
+    struct stats st;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "w:d:s:n:h")) != -1) {
+        switch (opt) {
+        case 'w': workload = optarg; break;
+        case 'd': dir = optarg; break;
+        case 's': size = atoi(optarg); break;
+        case 'n': count = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (workload == NULL || dir == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&st, 0, sizeof(st));
+    memset(buf, 0x5a, sizeof(buf));
+
+    if (!strcmp(workload, "install")) {
+        run_install(dir, count ? count : 20, (size ? size : 8) << 20, &st);
+    } else if (!strcmp(workload, "sqlite")) {
+        run_sqlite(dir, count ? count : 500, (size ? size : 4) << 20, &st);
+    } else if (!strcmp(workload, "mediascan")) {
+        run_mediascan(dir, count ? count : 1000, (size ? size : 256) << 10,
+                      &st);
+    } else if (!strcmp(workload, "seqread")) {
+        run_seqread(dir, count ? count : 3, (size ? size : 128) << 20, &st);
+    } else {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (st.count == 0) {
+        fprintf(stderr, "storage_bench: no operations recorded\n");
+        return 1;
+    }
+
+    qsort(st.lat_us, st.count, sizeof(double), cmp_double);
+    printf("%-10s ops %6u  MB/s %8.2f  p50 %9.0f us  p99 %9.0f us  "
+           "p99.9 %9.0f us  max %9.0f us\n",
+           workload, st.count, st.bytes / 1048576.0 / st.busy,
+           percentile(&st, 0.5), percentile(&st, 0.99),
+           percentile(&st, 0.999), st.lat_us[st.count - 1]);
+    return 0;
+}